@@ -0,0 +1,253 @@
+/****************************************************************
+Benchmarks for the BC118 library: how long the things that matter
+take on real hardware, printed as CSV so one run can be compared
+with the next.
+
+What it measures:
+  ready     - time from reset() to the module saying READY
+  get       - round trip for stdGetParam()
+  cmd       - round trip for stdCmd()
+  scan      - scan reports taken in per second while scanning
+  connect   - time for connect() to a given peripheral
+  send      - sendData() throughput, by payload size, as a central
+              (20-byte chunks) and as a peripheral (125-byte chunks)
+
+The connect and central send tests need a peripheral to talk to;
+put its address in peerAddress, or leave that empty to skip them.
+The peripheral send tests need a central to connect to us (a second
+BLE Mate 2 running this sketch as the peer works, as does a phone);
+we wait up to 30 seconds for one, then skip them.
+
+Code developed in Arduino 1.0.6, on an Arduino Pro 5V, using a
+SparkFun SmartBasic board to multiplex uploading and serial
+output.
+****************************************************************/
+
+#include <SparkFunBLEMate2.h>
+
+BLEMate2 BTModu(&Serial);
+
+// The peripheral to connect to for the central tests, as 12 hex digits.
+const char peerAddress[] = "";
+
+// How many times to repeat each of the quick tests.
+#define REPEATS 10
+
+// Payload sizes for the send tests.
+const unsigned int sendSizes[] = {20, 60, 125, 250, 1000};
+#define SEND_SIZES (sizeof(sendSizes) / sizeof(sendSizes[0]))
+
+// We can't print while the SmartBasic has the serial port pointed at the
+//  module, so results are kept here and printed all at once at the end.
+struct result
+{
+  const __FlashStringHelper *test;
+  unsigned int param;
+  unsigned long value;
+  const __FlashStringHelper *unit;
+};
+#define MAX_RESULTS 24
+result results[MAX_RESULTS];
+byte resultCount = 0;
+
+unsigned int payloadLeft = 0;
+unsigned int payloadPos = 0;
+unsigned int scanReports = 0;
+unsigned int startResyncs = 0;
+
+void setup()
+{
+  pinMode(2, OUTPUT);    // Control for the SmartBasic; see the bottom of the
+                         //  sketch.
+  Serial.begin(9600);    // This is the BC118 default baud rate.
+  selectBLE();
+
+  benchReady();
+  // The first command after power up always resyncs, since there's no
+  //  telling what the module heard before we got here; only the ones after
+  //  that say anything about the link.
+  startResyncs = BTModu.resyncCount();
+  benchCommands();
+  benchScan();
+  if (peerAddress[0] != '\0')
+  {
+    benchConnect();
+    benchSend(F("send_central"));
+    BTModu.disconnect();
+  }
+  // Like central mode, peripheral mode doesn't take until it's been written
+  //  and the module reset.
+  BTModu.BLEPeripheral();
+  BTModu.writeConfig();
+  BTModu.reset();
+  BTModu.BLEAdvertise();
+  if (waitForCentral(30000)) benchSend(F("send_peripheral"));
+
+  report();
+}
+
+void loop()
+{
+}
+
+void record(const __FlashStringHelper *test, unsigned int param,
+            unsigned long value, const __FlashStringHelper *unit)
+{
+  if (resultCount >= MAX_RESULTS) return;
+  results[resultCount].test = test;
+  results[resultCount].param = param;
+  results[resultCount].value = value;
+  results[resultCount].unit = unit;
+  resultCount++;
+}
+
+// Time to ready. The first reset also gets the module into a known state for
+//  everything after it.
+void benchReady()
+{
+  unsigned long total = 0;
+  for (byte i = 0; i < 3; i++)
+  {
+    unsigned long start = millis();
+    if (BTModu.reset() != BLEMate2::SUCCESS) return;
+    total += millis() - start;
+  }
+  record(F("ready"), 0, total / 3, F("ms"));
+}
+
+// Command round trips, averaged over REPEATS tries. These go one at a time;
+//  the pipelined numbers would be better, but this is what most sketches do.
+void benchCommands()
+{
+  String value;
+  unsigned long start = millis();
+  for (byte i = 0; i < REPEATS; i++)
+  {
+    BTModu.stdGetParam(F("NAME"), value);
+  }
+  record(F("get"), 0, (millis() - start) / REPEATS, F("ms"));
+
+  start = millis();
+  for (byte i = 0; i < REPEATS; i++)
+  {
+    BTModu.stdCmd(F("ADV OFF"));
+  }
+  record(F("cmd"), 0, (millis() - start) / REPEATS, F("ms"));
+}
+
+// Scan ingest: every report counts, including repeats from the same device,
+//  since handling each line is the work we're measuring.
+void countReport(const char *)
+{
+  scanReports++;
+}
+
+// The role setting only takes effect after a write and a reset, so that's
+//  part of getting ready to scan; it isn't counted in the time.
+void benchScan()
+{
+  BTModu.BLECentral();
+  BTModu.writeConfig();
+  BTModu.reset();
+  BTModu.onScanResult(countReport);
+  scanReports = 0;
+  unsigned long start = millis();
+  if (BTModu.startScanning() != BLEMate2::SUCCESS) return;
+  while (millis() - start < 5000)
+  {
+    BTModu.poll();
+  }
+  BTModu.stopScanning();
+  unsigned long elapsed = millis() - start;
+  BTModu.onScanResult(NULL);
+  record(F("scan"), 0, (scanReports * 1000UL) / elapsed, F("reports/s"));
+}
+
+// Connect, three times over; the last connection is left up for the central
+//  send test.
+void benchConnect()
+{
+  unsigned long total = 0;
+  byte connects = 0;
+  for (byte i = 0; i < 3; i++)
+  {
+    if (i > 0) BTModu.disconnect();
+    unsigned long start = millis();
+    if (BTModu.connect(peerAddress) != BLEMate2::SUCCESS) continue;
+    total += millis() - start;
+    connects++;
+  }
+  if (connects > 0) record(F("connect"), 0, total / connects, F("ms"));
+}
+
+// The payload is made up as it's sent, rather than sitting in a buffer, so
+//  the test doesn't cost a kilobyte of RAM.
+size_t fillPayload(char *buffer, size_t maxLen)
+{
+  size_t len = 0;
+  while (len < maxLen && payloadLeft > 0)
+  {
+    buffer[len++] = 'A' + (payloadPos++ % 26);
+    payloadLeft--;
+  }
+  return len;
+}
+
+void benchSend(const __FlashStringHelper *test)
+{
+  for (byte i = 0; i < SEND_SIZES; i++)
+  {
+    payloadLeft = sendSizes[i];
+    payloadPos = 0;
+    if (BTModu.sendData(fillPayload) != BLEMate2::SUCCESS) continue;
+    record(test, sendSizes[i], BTModu.sendRate(), F("bytes/s"));
+  }
+}
+
+boolean waitForCentral(unsigned long timeout)
+{
+  unsigned long start = millis();
+  while (millis() - start < timeout)
+  {
+    BTModu.poll();
+    if (BTModu.connectionState() == BLEMate2::SUCCESS) return true;
+  }
+  return false;
+}
+
+// test,param,value,unit; param is the payload size for the send tests and
+//  0 for everything else. The resync count (not counting the one we start
+//  with) is worth keeping an eye on too: if it isn't 0, something was
+//  garbling the link during the run.
+void report()
+{
+  selectPC();
+  Serial.println(F("test,param,value,unit"));
+  for (byte i = 0; i < resultCount; i++)
+  {
+    Serial.print(results[i].test);
+    Serial.print(',');
+    Serial.print(results[i].param);
+    Serial.print(',');
+    Serial.print(results[i].value);
+    Serial.print(',');
+    Serial.println(results[i].unit);
+  }
+  Serial.print(F("resyncs,0,"));
+  Serial.print(BTModu.resyncCount() - startResyncs);
+  Serial.println(F(",count"));
+}
+
+// Below this point are support functions for the SmartBasic. If you're not
+//  using the SmartBasic, you can leave this part off.
+void selectPC()
+{
+  Serial.flush();
+  digitalWrite(2, LOW);
+}
+
+void selectBLE()
+{
+  Serial.flush();
+  digitalWrite(2,HIGH);
+}
@@ -56,7 +56,7 @@ void setup()
   if (BTModu.reset() != BLEMate2::SUCCESS)
   {
     selectPC();
-    Serial.println("Module reset error!");
+    Serial.println(F("Module reset error!"));
     while (1);
   }
 
@@ -68,7 +68,7 @@ void setup()
   if (BTModu.restore() != BLEMate2::SUCCESS)
   {
     selectPC();
-    Serial.println("Module restore error!");
+    Serial.println(F("Module restore error!"));
     while (1);
   }
   // writeConfig() stores the current settings in non-volatile memory, so they
@@ -78,14 +78,14 @@ void setup()
   if (BTModu.writeConfig() != BLEMate2::SUCCESS)
   {
     selectPC();
-    Serial.println("Module write config error!");
+    Serial.println(F("Module write config error!"));
     while (1);
   }
   // One more reset, to make the changes take effect.
   if (BTModu.reset() != BLEMate2::SUCCESS)
   {
     selectPC();
-    Serial.println("Second module reset error!");
+    Serial.println(F("Second module reset error!"));
     while (1);
   }
   selectBLE();
@@ -134,7 +134,6 @@ void loop()
       fullBuffer = "";
     }
   }
-  static String inputBuffer;
   if (central)
   {
     doCentralExample(); // We're going to go to this function and never come
@@ -147,58 +146,49 @@ void loop()
 
     // When a remote module connects to us, we'll start to see a bunch of stuff.
     //  Most of that is just overhead; we don't really care about it. All we
-    //  *really* care about is data, and data looks like this:
-    // RCV=20 char max msg\n\r
-
-    // The state machine for capturing that can be pretty easy: when we've read
-    //  in \n\r, check to see if the string began with "RCV=". If yes, do
-    //  something. If no, discard it.
-    while (Serial.available() > 0)
+    //  *really* care about is data, and the library sorts that out from the
+    //  rest for us. BTModu works just like Serial does: available() tells us
+    //  how much data the remote device has sent, and read() gets it.
+    while (BTModu.available() > 0)
     {
-      inputBuffer.concat((char)Serial.read());
+      fullBuffer.concat((char)BTModu.read());
       lastRXTime = millis();
     }
-
-    // We'll probably see a lot of lines that end with \n\r- that's the default
-    //  line ending for all the connect info messages, for instance. We can
-    //  ignore all of them that don't start with "RCV=". Remember to clear your
-    //  String object after you find \n\r!!!
-    if (inputBuffer.endsWith("\n\r"))
-    {
-      if (inputBuffer.startsWith("RCV="))
-      {
-        inputBuffer.trim(); // Remove \n\r from end.
-        inputBuffer.remove(0,4); // Remove RCV= from front.
-        fullBuffer += inputBuffer;
-        inputBuffer = "";
-      }
-      else
-      {
-        inputBuffer = "";
-      }
-    }
   }
 }
 
 void setupCentralExample()
 {
   // We need to change some settings, first, to make this central mode thing
-  //  work like we want.
-
+  //  work like we want. None of these depend on the answer to the one before,
+  //  so rather than send one, wait for the answer, then send the next, we'll
+  //  queue them up as a batch with the begin*() functions. The library puts
+  //  them on the wire back to back, and if one fails, the rest of the batch
+  //  is dropped.
+  BTModu.beginBatch();
   // When ACON is ON, the BC118 will connect to the first BC118 it discovers,
   //  whether you want it to or not. We'll disable that.
-  BTModu.stdSetParam("ACON", "OFF");
+  BTModu.beginSetParam(F("ACON"), F("OFF"));
   // When CCON is ON, the BC118 will immediately start doing something after
   //  it disconnects. In central mode, it immediately starts scanning, and
   //  in peripheral mode, it immediately starts advertising. We don't want it
   //  to scan without our permission, so let's disable that.
-  BTModu.stdSetParam("CCON", "OFF");
+  BTModu.beginSetParam(F("CCON"), F("OFF"));
   // Turn off advertising. You actually need to do this, or the presence of
   //  the advertising flag can confuse the firmware when the module is in
   //  central mode.
-  BTModu.BLENoAdvertise();
+  BTModu.beginStdCmd(F("ADV OFF"));
   // Put the module in central mode.
-  BTModu.BLECentral();
+  BTModu.beginSetParam(F("CENT"), F("ON"));
+  BTModu.endBatch();
+  // waitForIdle() blocks until everything queued is done, and tells us
+  //  whether it all worked.
+  if (BTModu.waitForIdle() != BLEMate2::SUCCESS)
+  {
+    selectPC();
+    Serial.println(F("Central mode setup error!"));
+    while (1);
+  }
   // Store these changes.
   BTModu.writeConfig();
   // Reset the module. Write-reset is important here!!!!!!
@@ -221,18 +211,18 @@ void doCentralExample()
     if (result == BLEMate2::SUCCESS)
     {
       selectPC();
-      Serial.println("Success!");
+      Serial.println(F("Success!"));
       break;
     }
     else if (result == BLEMate2::REMOTE_ERROR)
     {
       selectPC();
-      Serial.println("Remote error!");
+      Serial.println(F("Remote error!"));
     }
     else if (result == BLEMate2::MODULE_ERROR)
     {
       selectPC();
-      Serial.println("Module error! Everybody panic!");
+      Serial.println(F("Module error! Everybody panic!"));
     }
   } 
   
@@ -245,9 +235,9 @@ void doCentralExample()
   String address;
 
   selectPC();
-  Serial.print("We found ");
+  Serial.print(F("We found "));
   Serial.print(numAddressesFound);
-  Serial.println(" BLE devices!");
+  Serial.println(F(" BLE devices!"));
   // We're going to iterate over numAddressesFound, print each address, and
   //  check to see if each one belongs to a BC118. The first BC118 we find,
   //  we'll connect to, but only after we report our address list.
@@ -266,7 +256,7 @@ void doCentralExample()
   BTModu.disconnect();
   delay(500);
   selectPC();
-  Serial.println("The End!");
+  Serial.println(F("The End!"));
   while(1);
 }
 
@@ -293,15 +283,15 @@ void setupPeripheralExample()
   //  want to tweak before we reset the device.
 
   // The CCON parameter will enable advertising immediately after a disconnect.
-  BTModu.stdSetParam("CCON", "ON");
+  BTModu.stdSetParam(F("CCON"), F("ON"));
   // The ADVP parameter controls the advertising rate. Can be FAST or SLOW.
-  BTModu.stdSetParam("ADVP", "FAST");
+  BTModu.stdSetParam(F("ADVP"), F("FAST"));
   // The ADVT parameter controls the timeout before advertising stops. Can be
   //  0 (for never) to 4260 (71min); integer value, in seconds.
-  BTModu.stdSetParam("ADVT", "0");
+  BTModu.stdSetParam(F("ADVT"), F("0"));
   // The ADDR parameter controls the devices we'll allow to connect to us.
   //  All zeroes is "anyone".
-  BTModu.stdSetParam("ADDR", "000000000000");
+  BTModu.stdSetParam(F("ADDR"), F("000000000000"));
 
   BTModu.writeConfig();
   BTModu.reset();
@@ -0,0 +1,655 @@
+/****************************************************************
+A BC118 on the other end of a Stream, for running the library on a PC.
+
+See BC118Emulator.h for what it does.
+
+This code is beerware; if you use it, please buy me (or any other
+SparkFun employee) a cold beverage next time you run into one of
+us at the local.
+****************************************************************/
+
+#include "BC118Emulator.h"
+#include <ctype.h>
+
+// The module's UART setting for each rate it supports.
+static const struct
+{
+  const char *code;
+  unsigned long baud;
+} baudCodes[] =
+{
+  {"000A", 2400}, {"0028", 9600}, {"004E", 19200}, {"009E", 38400},
+  {"00EB", 57600}, {"01D8", 115200}, {"03B0", 230400}, {"075F", 460800},
+};
+
+static unsigned long baudFromCode(const std::string &code)
+{
+  for (size_t i = 0; i < sizeof(baudCodes) / sizeof(baudCodes[0]); i++)
+  {
+    if (code == baudCodes[i].code) return baudCodes[i].baud;
+  }
+  return 9600;
+}
+
+BC118Emulator::BC118Emulator()
+{
+  _params = factory();
+  _nvm = _params;
+  _hostBaud = 9600;
+  _moduleBaud = 9600;
+  _central = false;
+  _booting = false;
+  _scanning = false;
+  _advertising = true;
+  _connected = false;
+  _address = "20FABB000001";
+  _scanGeneration = 0;
+  _inFree = 0;
+  _outFree = 0;
+  _busyUntil = 0;
+  _latency = 2;
+  _noise = 0;
+  _noiseSeed = 1;
+  _deaf = false;
+  _resetTime = 500;
+  _connectTime = 150;
+  resets = 0;
+}
+
+// What RTR puts back.
+BC118Emulator::settings BC118Emulator::factory()
+{
+  settings s;
+  s["UART"] = "0028";
+  s["CENT"] = "OFF";
+  s["ACON"] = "ON";
+  s["CCON"] = "ON";
+  s["SCNT"] = "0";
+  s["ADVP"] = "FAST";
+  s["ADVT"] = "0";
+  s["ADDR"] = "000000000000";
+  s["NAME"] = "BC118";
+  return s;
+}
+
+// Ten bits to a byte, with the start and stop bits.
+unsigned long BC118Emulator::byteTime(unsigned long baud)
+{
+  return 10000000UL / baud;
+}
+
+// What a byte sent at one rate looks like received at another. It's never a
+//  "\r" or a "\n", so junk never ends a line; it just garbles one.
+byte BC118Emulator::junk(byte c)
+{
+  return 0x80 | ((c * 7 + 3) & 0x7F);
+}
+
+byte BC118Emulator::noise(byte c)
+{
+  if (_noise == 0) return c;
+  _noiseSeed = _noiseSeed * 1103515245UL + 12345UL;
+  if ((_noiseSeed >> 8) % 1000000UL >= _noise) return c;
+  return c ^ (1 << ((_noiseSeed >> 4) & 7));
+}
+
+int BC118Emulator::available()
+{
+  hostAdvance(1);
+  run();
+  uint64_t now = hostMicros();
+  int n = 0;
+  for (size_t i = 0; i < _out.size() && _out[i].at <= now; i++) n++;
+  return n;
+}
+
+int BC118Emulator::read()
+{
+  if (available() == 0) return -1;
+  outByte b = _out.front();
+  _out.pop_front();
+  _outFree = b.at;
+  if (b.baud != _hostBaud) return junk(b.c);
+  return noise(b.c);
+}
+
+int BC118Emulator::peek()
+{
+  if (available() == 0) return -1;
+  const outByte &b = _out.front();
+  if (b.baud != _hostBaud) return junk(b.c);
+  return b.c;
+}
+
+// Each byte reaches the module once the ones before it have, one byte time
+//  apart. A command is carried out the moment its "\r" arrives. Like
+//  HardwareSerial, we only hold TX_BUFFER bytes that haven't gone out yet;
+//  past that, write() waits for room.
+size_t BC118Emulator::write(uint8_t c)
+{
+  run();
+  uint64_t now = hostMicros();
+  if (_inFree < now) _inFree = now;
+  uint64_t full = (uint64_t)TX_BUFFER * byteTime(_hostBaud);
+  if (_inFree > now + full) hostAdvance(_inFree - now - full);
+  _inFree += byteTime(_hostBaud);
+  if (_hostBaud != _moduleBaud) c = junk(c);
+  else c = noise(c);
+  if (_booting) return 1;
+
+  if (c == '\r')
+  {
+    std::string text = _in;
+    _in.clear();
+    command(text, _inFree);
+  }
+  else if (c != '\n')
+  {
+    _in += (char)c;
+  }
+  return 1;
+}
+
+// Like HardwareSerial::flush(), this waits until everything's gone out.
+void BC118Emulator::flush()
+{
+  uint64_t now = hostMicros();
+  if (_inFree > now) hostAdvance(_inFree - now);
+}
+
+void BC118Emulator::setHostBaud(unsigned long baud)
+{
+  _hostBaud = baud;
+}
+
+unsigned long BC118Emulator::hostBaud()
+{
+  return _hostBaud;
+}
+
+unsigned long BC118Emulator::moduleBaud()
+{
+  return _moduleBaud;
+}
+
+void BC118Emulator::setLatency(unsigned long ms)
+{
+  _latency = ms;
+}
+
+void BC118Emulator::setLatency(const char *prefix, unsigned long ms)
+{
+  _latencies[prefix] = ms;
+}
+
+void BC118Emulator::failNext(const char *prefix, unsigned int count)
+{
+  _failures[prefix] += count;
+}
+
+void BC118Emulator::setNoise(unsigned long perMillion)
+{
+  _noise = perMillion;
+}
+
+void BC118Emulator::setDeaf(boolean deaf)
+{
+  _deaf = deaf;
+}
+
+void BC118Emulator::setResetTime(unsigned long ms)
+{
+  _resetTime = ms;
+}
+
+void BC118Emulator::setConnectTime(unsigned long ms)
+{
+  _connectTime = ms;
+}
+
+void BC118Emulator::addDevice(const char *address, const char *name, int rssi,
+                              unsigned long interval, boolean connectable)
+{
+  device *d = findDevice(address);
+  if (d == NULL)
+  {
+    _devices.push_back(device());
+    d = &_devices.back();
+    d->address = address;
+    if (_scanning) schedule(hostMicros(), TIMER_REPORT, address);
+  }
+  d->name = name;
+  d->rssi = rssi;
+  d->interval = interval ? interval : 1;
+  d->connectable = connectable;
+}
+
+void BC118Emulator::removeDevice(const char *address)
+{
+  for (size_t i = 0; i < _devices.size(); i++)
+  {
+    if (_devices[i].address != address) continue;
+    _devices.erase(_devices.begin() + i);
+    return;
+  }
+}
+
+void BC118Emulator::remoteConnect(const char *address)
+{
+  run();
+  if (_connected || _central || !_advertising) return;
+  _connected = true;
+  _advertising = false;
+  _peer = address;
+  say("RPD=" + _peer, hostMicros());
+}
+
+void BC118Emulator::remoteDisconnect()
+{
+  run();
+  if (_connected) dropLink(hostMicros());
+}
+
+void BC118Emulator::remoteSend(const char *data)
+{
+  run();
+  if (_connected) say(std::string("RCV=") + data, hostMicros());
+}
+
+void BC118Emulator::sayLine(const char *line, unsigned long ms)
+{
+  run();
+  say(line, hostMicros() + ms * 1000ULL);
+}
+
+std::string BC118Emulator::param(const char *name)
+{
+  return _params[name];
+}
+
+std::string BC118Emulator::stored(const char *name)
+{
+  return _nvm[name];
+}
+
+boolean BC118Emulator::central()
+{
+  return _central;
+}
+
+boolean BC118Emulator::scanning()
+{
+  run();
+  return _scanning;
+}
+
+boolean BC118Emulator::advertising()
+{
+  run();
+  return _advertising;
+}
+
+boolean BC118Emulator::connected()
+{
+  run();
+  return _connected;
+}
+
+std::string BC118Emulator::peer()
+{
+  return _peer;
+}
+
+std::string BC118Emulator::address()
+{
+  return _address;
+}
+
+// Catch up on everything that should have happened by now, in order.
+void BC118Emulator::run()
+{
+  for (;;)
+  {
+    uint64_t now = hostMicros();
+    size_t next = _timers.size();
+    for (size_t i = 0; i < _timers.size(); i++)
+    {
+      if (_timers[i].at > now) continue;
+      if (next == _timers.size() || _timers[i].at < _timers[next].at) next = i;
+    }
+    if (next == _timers.size()) return;
+    timer t = _timers[next];
+    _timers.erase(_timers.begin() + next);
+    fire(t);
+  }
+}
+
+void BC118Emulator::schedule(uint64_t at, timerKind kind,
+                             const std::string &arg)
+{
+  timer t;
+  t.at = at;
+  t.kind = kind;
+  t.generation = _scanGeneration;
+  t.arg = arg;
+  _timers.push_back(t);
+}
+
+void BC118Emulator::fire(const timer &t)
+{
+  switch (t.kind)
+  {
+    // Coming out of reset, everything comes from NVM: the settings, the
+    //  role and the baud rate. A central starts out scanning, whether
+    //  anybody wants it to or not.
+    case TIMER_READY:
+      _booting = false;
+      _params = _nvm;
+      _moduleBaud = baudFromCode(_params["UART"]);
+      _central = _params["CENT"] == "ON";
+      _advertising = !_central;
+      _in.clear();
+      say("Melody Smart v2.6.0", t.at);
+      say("BlueCreation Copyright 2012 - 2014", t.at);
+      say("www.bluecreation.com", t.at);
+      say("READY", t.at);
+      if (_central) startScan(t.at);
+      break;
+
+    case TIMER_REPORT:
+    {
+      if (!_scanning || t.generation != _scanGeneration) break;
+      device *d = findDevice(t.arg);
+      if (d == NULL) break;
+      char line[80];
+      snprintf(line, sizeof(line), "SCN=%c %s %s %d 0201061AFF4C00",
+               d->connectable ? 'P' : 'N', d->address.c_str(),
+               d->name.c_str(), d->rssi);
+      say(line, t.at);
+      schedule(t.at + d->interval * 1000ULL, TIMER_REPORT, d->address);
+      break;
+    }
+
+    // A timed scan just stops; the module doesn't say so.
+    case TIMER_SCAN_END:
+      if (t.generation == _scanGeneration) _scanning = false;
+      break;
+
+    case TIMER_CONNECT:
+    {
+      device *d = findDevice(t.arg);
+      if (!_scanning || _connected || d == NULL || !d->connectable) break;
+      _scanning = false;
+      _scanGeneration++;
+      _connected = true;
+      _peer = t.arg;
+      say("RPD=" + _peer, t.at);
+      break;
+    }
+
+    case TIMER_DISCONNECT:
+      if (_connected) dropLink(t.at);
+      break;
+  }
+}
+
+// Queue a line for the library. Lines go out in the order they're meant to
+//  start, so an event doesn't wait behind the answer to a command the module
+//  is still thinking about; the bytes go out one after another at the rate
+//  the module is at now.
+void BC118Emulator::say(const std::string &line, uint64_t at)
+{
+  std::string text = line + "\n\r";
+  size_t i = _out.size();
+  while (i > 0 && _out[i-1].start > at) i--;
+  for (size_t j = 0; j < text.size(); j++)
+  {
+    outByte b;
+    b.at = 0;
+    b.start = at;
+    b.c = text[j];
+    b.baud = _moduleBaud;
+    _out.insert(_out.begin() + i + j, b);
+  }
+
+  // Everything from the new line on gets its time again.
+  uint64_t t = (i > 0) ? _out[i-1].at : _outFree;
+  for (size_t j = i; j < _out.size(); j++)
+  {
+    if (t < _out[j].start) t = _out[j].start;
+    t += byteTime(_out[j].baud);
+    _out[j].at = t;
+  }
+}
+
+unsigned long BC118Emulator::latencyFor(const std::string &text)
+{
+  unsigned long ms = _latency;
+  size_t longest = 0;
+  for (std::map<std::string, unsigned long>::iterator i = _latencies.begin();
+       i != _latencies.end(); ++i)
+  {
+    if (text.compare(0, i->first.size(), i->first) != 0) continue;
+    if (i->first.size() < longest) continue;
+    longest = i->first.size();
+    ms = i->second;
+  }
+  return ms;
+}
+
+boolean BC118Emulator::failing(const std::string &text)
+{
+  for (std::map<std::string, unsigned int>::iterator i = _failures.begin();
+       i != _failures.end(); ++i)
+  {
+    if (i->second == 0) continue;
+    if (text.compare(0, i->first.size(), i->first) != 0) continue;
+    i->second--;
+    return true;
+  }
+  return false;
+}
+
+// The answer to a command: the line, after the module's had time to think.
+void BC118Emulator::reply(const std::string &text, const std::string &line,
+                          uint64_t at, unsigned long extra)
+{
+  uint64_t t = at + (latencyFor(text) + extra) * 1000ULL;
+  if (t > _busyUntil) _busyUntil = t;
+  say(line, t);
+}
+
+// The module works through commands one at a time; one that arrives while
+//  it's still thinking about the last one waits its turn.
+void BC118Emulator::command(const std::string &text, uint64_t at)
+{
+  if (at < _busyUntil) at = _busyUntil;
+  commands.push_back(text);
+  if (_deaf) return;
+  if (text.empty() || failing(text))
+  {
+    reply(text, "ERR", at);
+    return;
+  }
+
+  if (text.compare(0, 4, "SET ") == 0)
+  {
+    size_t eq = text.find('=');
+    std::string name = text.substr(4, eq == std::string::npos ? 0 : eq - 4);
+    if (eq == std::string::npos || _params.count(name) == 0)
+    {
+      reply(text, "ERR", at);
+      return;
+    }
+    _params[name] = text.substr(eq + 1);
+    reply(text, "OK", at);
+  }
+  else if (text.compare(0, 4, "GET ") == 0)
+  {
+    std::string name = text.substr(4);
+    if (_params.count(name) == 0)
+    {
+      reply(text, "ERR", at);
+      return;
+    }
+    reply(text, name + "=" + _params[name], at);
+    reply(text, "OK", at);
+  }
+  // STS reports the CENT setting, not the role the module is actually in;
+  //  that's one of the ways the real module lies about it.
+  else if (text == "STS")
+  {
+    const char *state = _connected ? "CONNECTED" : _scanning ? "SCANNING" :
+                        _advertising ? "ADVERTISING" : "IDLE";
+    reply(text, std::string("STS ") + (_params["CENT"] == "ON" ? "C " : "P ") +
+                state, at);
+    reply(text, "OK", at);
+  }
+  // VER never does send an OK.
+  else if (text == "VER")
+  {
+    reply(text, "BlueCreation Copyright 2012-2014", at);
+    reply(text, "www.bluecreation.com", at);
+    reply(text, "Melody Smart v2.6.0", at);
+    reply(text, "Build: 1234", at);
+    reply(text, "Bluetooth Address " + _address, at);
+  }
+  else if (text == "WRT")
+  {
+    _nvm = _params;
+    reply(text, "OK", at);
+  }
+  else if (text == "RTR")
+  {
+    _params = factory();
+    reply(text, "OK", at);
+  }
+  else if (text == "RST")
+  {
+    resets++;
+    _booting = true;
+    _scanning = false;
+    _scanGeneration++;
+    _advertising = false;
+    _connected = false;
+    _in.clear();
+    schedule(at + (latencyFor(text) + _resetTime) * 1000ULL, TIMER_READY);
+  }
+  else if (text == "ADV ON")
+  {
+    if (_central || _connected)
+    {
+      reply(text, "ERR", at);
+      return;
+    }
+    _advertising = true;
+    reply(text, "OK", at);
+  }
+  else if (text == "ADV OFF")
+  {
+    _advertising = false;
+    reply(text, "OK", at);
+  }
+  // Scanning only works once the module has come out of reset as a
+  //  central; SET CENT=ON on its own isn't enough.
+  else if (text == "SCN ON")
+  {
+    if (!_central || _connected)
+    {
+      reply(text, "ERR", at);
+      return;
+    }
+    reply(text, "OK", at);
+    startScan(at + latencyFor(text) * 1000ULL);
+  }
+  else if (text == "SCN OFF")
+  {
+    _scanning = false;
+    _scanGeneration++;
+    reply(text, "OK", at);
+  }
+  else if (text.compare(0, 4, "CON ") == 0)
+  {
+    std::string peer = text.substr(4, 12);
+    if (text.size() != 18 || text.compare(16, 2, " 0") != 0 ||
+        !isAddress(peer) || !_scanning)
+    {
+      reply(text, "ERR", at);
+      return;
+    }
+    reply(text, "OK", at);
+    schedule(at + (latencyFor(text) + _connectTime) * 1000ULL, TIMER_CONNECT,
+             peer);
+  }
+  else if (text == "DCN")
+  {
+    if (!_connected)
+    {
+      reply(text, "ERR", at);
+      return;
+    }
+    reply(text, "OK", at);
+    schedule(at + (latencyFor(text) + 20) * 1000ULL, TIMER_DISCONNECT);
+  }
+  // The most a SND can carry depends on the role: 20 bytes as a central,
+  //  125 as a peripheral.
+  else if (text.compare(0, 4, "SND ") == 0)
+  {
+    size_t len = text.size() - 4;
+    if (!_connected || len > (_central ? 20U : 125U))
+    {
+      reply(text, "ERR", at);
+      return;
+    }
+    sent += text.substr(4);
+    reply(text, "OK", at);
+  }
+  else
+  {
+    reply(text, "ERR", at);
+  }
+}
+
+// Every device gets reported a little after the scan starts, and then every
+//  time it advertises.
+void BC118Emulator::startScan(uint64_t at)
+{
+  _scanning = true;
+  _scanGeneration++;
+  for (size_t i = 0; i < _devices.size(); i++)
+  {
+    schedule(at + (i * 7 + 5) * 1000ULL, TIMER_REPORT, _devices[i].address);
+  }
+  unsigned long seconds = strtoul(_params["SCNT"].c_str(), NULL, 10);
+  if (seconds > 0) schedule(at + seconds * 1000000ULL, TIMER_SCAN_END);
+}
+
+// With CCON on, a module that loses its connection goes straight back to
+//  what it was doing before: advertising, or scanning.
+void BC118Emulator::dropLink(uint64_t at)
+{
+  _connected = false;
+  say("DCN", at);
+  if (_params["CCON"] != "ON") return;
+  if (_central) startScan(at);
+  else _advertising = true;
+}
+
+BC118Emulator::device *BC118Emulator::findDevice(const std::string &address)
+{
+  for (size_t i = 0; i < _devices.size(); i++)
+  {
+    if (_devices[i].address == address) return &_devices[i];
+  }
+  return NULL;
+}
+
+boolean BC118Emulator::isAddress(const std::string &text)
+{
+  if (text.size() != 12) return false;
+  for (size_t i = 0; i < text.size(); i++)
+  {
+    if (!isxdigit((byte)text[i])) return false;
+  }
+  return true;
+}
@@ -0,0 +1,185 @@
+/****************************************************************
+A BC118 on the other end of a Stream, for running the library on a PC.
+
+The emulator speaks the part of the BC118's command set the library
+uses (RST, RTR, WRT, STS, GET, SET, VER, ADV, SCN, CON, DCN, SND),
+answering each command with the lines the real module sends, ending
+in "\n\r", at the time the real module would send them: nothing
+arrives before the command it answers has finished going out at the
+current baud rate, plus however long the module takes to think about
+it. Settings live in RAM until WRT puts them in NVM, and RST brings
+back whatever's in NVM, the baud rate and the role included, just as
+it does on the real module.
+
+Everything about it can be scripted from a test: how long it takes
+to answer, which commands get ERR back, noise on the line, devices
+for it to find when it scans, and a remote device that connects,
+disconnects and sends data.
+
+All times are simulated; see the top of shim/Arduino.h.
+
+This code is beerware; if you use it, please buy me (or any other
+SparkFun employee) a cold beverage next time you run into one of
+us at the local.
+****************************************************************/
+
+#ifndef BC118Emulator_h
+#define BC118Emulator_h
+
+#include <Arduino.h>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+class BC118Emulator : public Stream
+{
+  public:
+    BC118Emulator();
+
+    // The library's side of the serial link.
+    int available();
+    int read();
+    int peek();
+    size_t write(uint8_t c);
+    using Print::write;
+    void flush();
+
+    // The rate the Arduino's end of the link is set to (the module's is
+    //  whatever its UART setting was at the last reset). When they differ,
+    //  everything comes through as junk, both ways.
+    void setHostBaud(unsigned long baud);
+    unsigned long hostBaud();
+    unsigned long moduleBaud();
+
+    // How long the module takes to answer, in milliseconds, on top of the
+    //  time the bytes take on the wire: for every command, or for the ones
+    //  that start with a given prefix ("WRT", say, or "SET CENT").
+    void setLatency(unsigned long ms);
+    void setLatency(const char *prefix, unsigned long ms);
+
+    // Answer the next count commands that start with prefix with ERR,
+    //  whatever they are. "" matches everything.
+    void failNext(const char *prefix, unsigned int count = 1);
+
+    // Corrupt about this many bytes in every million, in either direction.
+    void setNoise(unsigned long perMillion);
+
+    // A deaf module hears everything and answers nothing.
+    void setDeaf(boolean deaf);
+
+    // How long a reset takes, to READY, and a connection, from CON to RPD.
+    void setResetTime(unsigned long ms);
+    void setConnectTime(unsigned long ms);
+
+    // Devices for the module to find while it scans. Each one advertises
+    //  every interval milliseconds at the given signal strength. Adding an
+    //  address that's already there updates it.
+    void addDevice(const char *address, const char *name, int rssi,
+                   unsigned long interval = 100, boolean connectable = true);
+    void removeDevice(const char *address);
+
+    // The remote end of a connection. remoteConnect() is a central
+    //  connecting to us (we have to be advertising); the others work however
+    //  the connection was made.
+    void remoteConnect(const char *address);
+    void remoteDisconnect();
+    void remoteSend(const char *data);
+
+    // Put any line at all on the wire, ms from now.
+    void sayLine(const char *line, unsigned long ms = 0);
+
+    // What the module has seen and done.
+    std::vector<std::string> commands;  // every command line, in order
+    std::string sent;                   // the data from every SND
+    unsigned int resets;
+    std::string param(const char *name);
+    std::string stored(const char *name);
+    boolean central();
+    boolean scanning();
+    boolean advertising();
+    boolean connected();
+    std::string peer();
+    std::string address();
+
+  private:
+    // The size of an AVR HardwareSerial's transmit buffer.
+    enum {TX_BUFFER = 64};
+
+    struct outByte
+    {
+      uint64_t at;
+      uint64_t start;
+      byte c;
+      unsigned long baud;
+    };
+
+    enum timerKind {TIMER_READY, TIMER_REPORT, TIMER_SCAN_END, TIMER_CONNECT,
+                    TIMER_DISCONNECT};
+    struct timer
+    {
+      uint64_t at;
+      timerKind kind;
+      unsigned int generation;
+      std::string arg;
+    };
+
+    struct device
+    {
+      std::string address;
+      std::string name;
+      int rssi;
+      unsigned long interval;
+      boolean connectable;
+    };
+
+    typedef std::map<std::string, std::string> settings;
+
+    settings _params;
+    settings _nvm;
+    unsigned long _hostBaud;
+    unsigned long _moduleBaud;
+    boolean _central;
+    boolean _booting;
+    boolean _scanning;
+    boolean _advertising;
+    boolean _connected;
+    std::string _peer;
+    std::string _address;
+    unsigned int _scanGeneration;
+    std::string _in;
+    uint64_t _inFree;
+    std::deque<outByte> _out;
+    uint64_t _outFree;
+    uint64_t _busyUntil;
+    std::vector<timer> _timers;
+    std::vector<device> _devices;
+    std::map<std::string, unsigned long> _latencies;
+    std::map<std::string, unsigned int> _failures;
+    unsigned long _latency;
+    unsigned long _noise;
+    unsigned long _noiseSeed;
+    boolean _deaf;
+    unsigned long _resetTime;
+    unsigned long _connectTime;
+
+    static settings factory();
+    static unsigned long byteTime(unsigned long baud);
+    byte junk(byte c);
+    byte noise(byte c);
+    void run();
+    void schedule(uint64_t at, timerKind kind, const std::string &arg = "");
+    void fire(const timer &t);
+    void say(const std::string &line, uint64_t at);
+    void command(const std::string &text, uint64_t at);
+    unsigned long latencyFor(const std::string &text);
+    boolean failing(const std::string &text);
+    void reply(const std::string &text, const std::string &line,
+               uint64_t at, unsigned long extra = 0);
+    void startScan(uint64_t at);
+    void dropLink(uint64_t at);
+    device *findDevice(const std::string &address);
+    static boolean isAddress(const std::string &text);
+};
+
+#endif
@@ -0,0 +1,137 @@
+/****************************************************************
+Plays back a trace from BLEMate2::dumpTrace().
+
+See TraceReplay.h for what it does.
+
+This code is beerware; if you use it, please buy me (or any other
+SparkFun employee) a cold beverage next time you run into one of
+us at the local.
+****************************************************************/
+
+#include "TraceReplay.h"
+
+TraceReplay::TraceReplay()
+{
+  _next = 0;
+  _pos = 0;
+  _lastAt = millis();
+  _written = 0;
+  _mismatches = 0;
+  _firstMismatch = 0;
+}
+
+// Each trace line is "<ms> T|R <hex byte> <hex byte>...". Anything else on a
+//  line of its own is something else the sketch printed.
+size_t TraceReplay::load(const char *text)
+{
+  size_t found = 0;
+  while (*text != '\0')
+  {
+    const char *end = text + strcspn(text, "\r\n");
+    std::string line(text, end - text);
+    text = end + strspn(end, "\r\n");
+
+    char *p;
+    event e;
+    e.at = strtoul(line.c_str(), &p, 10);
+    if (p == line.c_str() || *p != ' ') continue;
+    p++;
+    if (*p != 'T' && *p != 'R') continue;
+    e.tx = (*p == 'T');
+    p++;
+    while (*p == ' ')
+    {
+      char *hexEnd;
+      unsigned long c = strtoul(p + 1, &hexEnd, 16);
+      if (hexEnd != p + 3 || c > 0xFF) break;
+      e.bytes += (char)c;
+      p = hexEnd;
+    }
+    if (e.bytes.empty() || *p != '\0') continue;
+
+    // dumpTrace() starts a new line whenever the bytes pause, even going the
+    //  same way. There's nothing to gain from keeping those apart.
+    if (!_events.empty() && _events.back().tx == e.tx && _events.back().tx)
+    {
+      _events.back().bytes += e.bytes;
+    }
+    else _events.push_back(e);
+    found += e.bytes.size();
+  }
+  return found;
+}
+
+void TraceReplay::finishEvent()
+{
+  _next++;
+  _pos = 0;
+  _lastAt = millis();
+}
+
+// Let out whatever the module had sent by now: the received lines in front
+//  of the next thing the library has to write, each once its time is up.
+void TraceReplay::run()
+{
+  while (_next < _events.size() && !_events[_next].tx)
+  {
+    unsigned long gap = 0;
+    if (_next > 0) gap = _events[_next].at - _events[_next - 1].at;
+    if (millis() - _lastAt < gap) return;
+    const std::string &bytes = _events[_next].bytes;
+    for (size_t i = 0; i < bytes.size(); i++) _in.push_back(bytes[i]);
+    finishEvent();
+  }
+}
+
+int TraceReplay::available()
+{
+  hostAdvance(1);
+  run();
+  return _in.size();
+}
+
+int TraceReplay::read()
+{
+  if (available() == 0) return -1;
+  byte c = _in.front();
+  _in.pop_front();
+  return c;
+}
+
+int TraceReplay::peek()
+{
+  if (available() == 0) return -1;
+  return _in.front();
+}
+
+// Once the library has gone off the trace, nothing more it says matches up
+//  with anything, so the replay stops where it is.
+size_t TraceReplay::write(uint8_t c)
+{
+  run();
+  size_t offset = _written++;
+  if (_mismatches > 0 || _next >= _events.size() || !_events[_next].tx ||
+      (byte)_events[_next].bytes[_pos] != c)
+  {
+    if (_mismatches++ == 0) _firstMismatch = offset;
+    return 1;
+  }
+  if (++_pos == _events[_next].bytes.size()) finishEvent();
+  return 1;
+}
+
+boolean TraceReplay::done()
+{
+  run();
+  return _next >= _events.size();
+}
+
+unsigned int TraceReplay::mismatches()
+{
+  return _mismatches;
+}
+
+size_t TraceReplay::firstMismatch()
+{
+  return _firstMismatch;
+}
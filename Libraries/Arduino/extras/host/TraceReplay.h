@@ -0,0 +1,73 @@
+/****************************************************************
+Plays back a trace from BLEMate2::dumpTrace(), standing in for the
+module it was taken from.
+
+Give it the text dumpTrace() printed (a whole serial log is fine;
+lines that aren't trace lines are skipped) and hand it to a BLEMate2
+in place of the module. What the module sent comes back out at the
+times it did, measured from whatever came just before it in the
+trace: a reply turns up as long after the library finishes writing
+the command as it did when the trace was taken. What the library
+writes is checked against what it wrote back then. If the library
+goes a different way (a change to it, or a sketch that doesn't make
+the same calls), the replay stops and mismatches() says where.
+
+The trace keeps whole lines together but not the gaps between the
+bytes in them, so each received line arrives all at once.
+
+This code is beerware; if you use it, please buy me (or any other
+SparkFun employee) a cold beverage next time you run into one of
+us at the local.
+****************************************************************/
+
+#ifndef TraceReplay_h
+#define TraceReplay_h
+
+#include <Arduino.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+class TraceReplay : public Stream
+{
+  public:
+    TraceReplay();
+
+    // Add a trace to play back. Returns the number of bytes found in it.
+    size_t load(const char *text);
+
+    int available();
+    int read();
+    int peek();
+    size_t write(uint8_t c);
+    using Print::write;
+
+    // Whether everything in the trace has been played back, and how many
+    //  bytes the library wrote that weren't what the trace said it would.
+    //  The first of those is at offset firstMismatch() in what it wrote.
+    boolean done();
+    unsigned int mismatches();
+    size_t firstMismatch();
+
+  private:
+    struct event
+    {
+      unsigned long at;      // ms, as dumpTrace() printed it
+      boolean tx;
+      std::string bytes;
+    };
+
+    std::vector<event> _events;
+    size_t _next;
+    size_t _pos;             // how far into _events[_next] we are
+    unsigned long _lastAt;   // when the event before _next finished
+    std::deque<byte> _in;
+    size_t _written;
+    unsigned int _mismatches;
+    size_t _firstMismatch;
+
+    void run();
+    void finishEvent();
+};
+
+#endif
@@ -0,0 +1,744 @@
+/****************************************************************
+The benchmarks from the SparkFunBenchmark example, run against the
+emulator instead of a module, so a change to the library can be
+measured without any hardware and compared run to run.
+
+The numbers are in simulated time (see the top of shim/Arduino.h),
+so they're the same every run on every machine; what they measure
+is how well the library uses the link and the module, not how fast
+the PC is. The tests and the output match the sketch's:
+
+  ready     - time from reset() to the module saying READY
+  get       - round trip for stdGetParam()
+  cmd       - round trip for stdCmd()
+  cmd_resync - the same, with a resync in front of it; that's what
+              every command cost before the library kept track of
+              whether it was in step with the module
+  scan      - scan reports taken in per second while scanning
+  scan_ingest - the same at 460800 baud, whatever --baud says, by
+              device count, along with how many reports the devices
+              offer, how many the wire can carry (a report is 44
+              bytes), and the most that one poll() had to handle
+  scan_cpu  - host CPU time per scan report, in nanoseconds, with the
+              reports coming as fast as the library can take them. This
+              one's real time, like send_cpu.
+  connect   - time for connect() to a given peripheral
+  config    - the startup sequence from SparkFunLibraryTest (two SETs,
+              ADV OFF, central mode and a write) as one batch, by
+              pipeline depth; depth 1 is one command at a time, the way
+              it used to be. The reset that follows it there takes as
+              long either way, so it's left out.
+  send      - sendData() throughput, by payload size, as a central
+              and as a peripheral
+  frame     - BLEMate2Framer against raw sendData(), as a peripheral,
+              by payload size: payload bytes per second for raw text,
+              for the same text framed, and for random binary framed,
+              and how many more bytes each framed kind puts on the
+              wire, as a percentage of the payload
+  group     - sendAll() from a BLEMate2Group of 1 to 4 modules, all
+              peripherals, by module count: bytes per second across the
+              group, the slowest module's rate, and the group rate from
+              sending on each module in turn, which is what plain
+              sendData() calls would get
+  send_heap - heap allocations made by each of the buffer flavours of
+              sendData() (by payload size), which should all be none
+  send_cpu  - host CPU time per payload byte for sendData(), in
+              nanoseconds. Unlike everything else here, this one is
+              real time, so it's only good for comparing runs on the
+              same machine.
+
+Options:
+  --baud N        serial rate to run at (autoBaud() gets us there);
+                  9600 by default
+  --latency MS    how long the module takes to answer each command
+  --reset MS      how long a reset takes, to READY
+  --connect MS    how long a connection takes, from CON to RPD
+  --repeats N     how many times to repeat the quick tests
+  --json          JSON instead of CSV
+
+This code is beerware; if you use it, please buy me (or any other
+SparkFun employee) a cold beverage next time you run into one of
+us at the local.
+****************************************************************/
+
+#include <BC118Emulator.h>
+#include <SparkFunBLEMate2.h>
+#include <SparkFunFraming.h>
+#include <SparkFunGroup.h>
+#include <chrono>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+struct settings
+{
+  unsigned long baud;
+  long latency;        // -1 for whatever the emulator does by default
+  long resetTime;
+  long connectTime;
+  unsigned int repeats;
+  bool json;
+};
+
+struct result
+{
+  std::string test;
+  unsigned int param;
+  unsigned long value;
+  std::string unit;
+};
+
+static settings config = {9600, -1, -1, -1, 10, false};
+static std::vector<result> results;
+static unsigned int failures;
+
+static const char peerAddress[] = "20FABB000010";
+static const unsigned int sendSizes[] = {20, 60, 125, 250, 1000};
+#define SEND_SIZES (sizeof(sendSizes) / sizeof(sendSizes[0]))
+
+static BC118Emulator *current;
+
+// Every allocation in the program comes through here, so the send tests can
+//  count the ones made while they're counting.
+static bool countingAllocs;
+static unsigned long allocs;
+
+void *operator new(size_t size)
+{
+  if (countingAllocs) allocs++;
+  void *p = malloc(size ? size : 1);
+  if (p == NULL) throw std::bad_alloc();
+  return p;
+}
+
+// These mustn't be inlined; GCC sees the free() underneath as not matching
+//  a new, and warns.
+__attribute__((noinline)) void operator delete(void *p) noexcept
+{
+  free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept
+{
+  free(p);
+}
+
+static void record(const char *test, unsigned int param, unsigned long value,
+                   const char *unit)
+{
+  result r = {test, param, value, unit};
+  results.push_back(r);
+}
+
+// Anything that goes wrong is noted and the test that hit it skipped; the
+//  exit status says how many there were.
+static bool check(BLEMate2::opResult result, const char *what)
+{
+  if (result == BLEMate2::SUCCESS) return true;
+  fprintf(stderr, "%s failed (%d)\n", what, (int)result);
+  failures++;
+  return false;
+}
+
+static void setHostBaud(unsigned long baud)
+{
+  current->setHostBaud(baud);
+}
+
+// A fresh module with the settings from the command line, and a library
+//  talking to it at the right rate. Every test starts from one of these, so
+//  none of them sees what the one before left behind.
+static bool setUp(BC118Emulator &module, BLEMate2 &ble, bool central,
+                  unsigned long baud = 0)
+{
+  if (baud == 0) baud = config.baud;
+  current = &module;
+  if (config.latency >= 0) module.setLatency(config.latency);
+  if (config.resetTime >= 0) module.setResetTime(config.resetTime);
+  if (config.connectTime >= 0) module.setConnectTime(config.connectTime);
+  if (!check(ble.reset(), "reset()")) return false;
+  if (baud != 9600)
+  {
+    if (!check(ble.autoBaud(setHostBaud, baud), "autoBaud()"))
+    {
+      return false;
+    }
+    if (ble.getBaudRate() != baud)
+    {
+      fprintf(stderr, "autoBaud() stopped at %lu\n", ble.getBaudRate());
+      failures++;
+      return false;
+    }
+  }
+  if (!central) return true;
+  // The role only changes with a write and a reset, same as on the module.
+  if (!check(ble.BLECentral(), "BLECentral()")) return false;
+  if (!check(ble.writeConfig(), "writeConfig()")) return false;
+  return check(ble.reset(), "reset()");
+}
+
+static void benchReady()
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  if (!setUp(module, ble, false)) return;
+  unsigned long total = 0;
+  for (unsigned int i = 0; i < config.repeats; i++)
+  {
+    unsigned long start = millis();
+    if (!check(ble.reset(), "reset()")) return;
+    total += millis() - start;
+  }
+  record("ready", 0, total / config.repeats, "ms");
+}
+
+static void benchCommands()
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  if (!setUp(module, ble, false)) return;
+
+  String value;
+  unsigned long start = millis();
+  for (unsigned int i = 0; i < config.repeats; i++)
+  {
+    if (!check(ble.stdGetParam("NAME", value), "stdGetParam()")) return;
+  }
+  record("get", 0, (millis() - start) / config.repeats, "ms");
+
+  start = millis();
+  for (unsigned int i = 0; i < config.repeats; i++)
+  {
+    if (!check(ble.stdCmd("ADV OFF"), "stdCmd()")) return;
+  }
+  record("cmd", 0, (millis() - start) / config.repeats, "ms");
+
+  // A line too long to make sense of puts us out of step. It takes a while
+  //  on the wire, so it's let through before the clock starts.
+  unsigned long total = 0;
+  std::string junk(BLE_MATE2_LINE_SIZE + 10, 'x');
+  for (unsigned int i = 0; i < config.repeats; i++)
+  {
+    module.sayLine(junk.c_str());
+    start = millis();
+    while (millis() - start < 500) ble.poll();
+    start = millis();
+    if (!check(ble.stdCmd("ADV OFF"), "stdCmd()")) return;
+    total += millis() - start;
+  }
+  record("cmd_resync", 0, total / config.repeats, "ms");
+}
+
+// Every report counts, repeats from the same device included, since
+//  handling each line is the work being measured. Twenty devices, each
+//  advertising every 100 ms, is a busy room.
+static unsigned int scanReports;
+
+static void countReport(const char *)
+{
+  scanReports++;
+}
+
+static void benchScan()
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  if (!setUp(module, ble, true)) return;
+  char address[13];
+  for (unsigned int i = 0; i < 20; i++)
+  {
+    snprintf(address, sizeof(address), "20FABB0001%02X", i);
+    module.addDevice(address, "bench", -40 - (int)i);
+  }
+  ble.onScanResult(countReport);
+  scanReports = 0;
+  unsigned long start = millis();
+  if (!check(ble.startScanning(), "startScanning()")) return;
+  while (millis() - start < 5000) ble.poll();
+  ble.stopScanning();
+  unsigned long elapsed = millis() - start;
+  ble.onScanResult(NULL);
+  record("scan", 0, (scanReports * 1000UL) / elapsed, "reports/s");
+}
+
+// Each device advertises every 20 ms, so 100 of them offer 5000 reports a
+//  second, which is about what 460800 baud can carry. The scan table is
+//  much smaller than that, so it's churning the whole time, too.
+static void benchScanIngest(unsigned int devices)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  if (!setUp(module, ble, true, 460800)) return;
+  char address[13];
+  for (unsigned int i = 0; i < devices; i++)
+  {
+    snprintf(address, sizeof(address), "20FABB01%04X", i & 0xFFFF);
+    module.addDevice(address, "bench", -40 - (int)(i % 50), 20);
+  }
+  ble.onScanResult(countReport);
+  scanReports = 0;
+  unsigned int most = 0;
+  unsigned long start = millis();
+  if (!check(ble.startScanning(), "startScanning()")) return;
+  while (millis() - start < 2000)
+  {
+    unsigned int before = scanReports;
+    ble.poll();
+    if (scanReports - before > most) most = scanReports - before;
+  }
+  ble.stopScanning();
+  unsigned long elapsed = millis() - start;
+  ble.onScanResult(NULL);
+  record("scan_offered", devices, devices * 1000UL / 20, "reports/s");
+  record("scan_wire", devices, 460800UL / 10 / 44, "reports/s");
+  record("scan_ingest", devices, (scanReports * 1000UL) / elapsed,
+         "reports/s");
+  record("scan_per_poll", devices, most, "reports");
+}
+
+// No wire we can run the module at carries more than about a thousand
+//  reports a second, so to see how many the library itself could keep up
+//  with, this hands them over with no wire at all: each fill() makes that
+//  many reports ready to read, from devices taking turns, and anything
+//  written to it is thrown away.
+class scanFeed : public Stream
+{
+  public:
+    scanFeed(unsigned int devices) : _devices(devices), _device(0),
+                                     _lines(0), _pos(0) { makeLine(); }
+    void fill(unsigned int lines) { _lines = lines; }
+    int available() { return _lines > 0 ? (int)(_len - _pos) : 0; }
+    int peek() { return _lines > 0 ? (byte)_line[_pos] : -1; }
+    int read()
+    {
+      if (_lines == 0) return -1;
+      int c = (byte)_line[_pos++];
+      if (_pos == _len)
+      {
+        _lines--;
+        _device = (_device + 1) % _devices;
+        makeLine();
+      }
+      return c;
+    }
+    size_t write(uint8_t) { return 1; }
+    using Print::write;
+
+  private:
+    void makeLine()
+    {
+      _len = snprintf(_line, sizeof(_line),
+                      "SCN=P 20FABB01%04X bench -40 0201061AFF4C00\n\r",
+                      _device & 0xFFFF);
+      _pos = 0;
+    }
+    unsigned int _devices;
+    unsigned int _device;
+    unsigned int _lines;
+    char _line[64];
+    size_t _len;
+    size_t _pos;
+};
+
+static void benchScanCpu()
+{
+  const unsigned int perPoll = 50;
+  const unsigned int rounds = 200 * config.repeats;
+  scanFeed feed(100);
+  BLEMate2 ble(&feed);
+  ble.onScanResult(countReport);
+  scanReports = 0;
+  std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
+  for (unsigned int i = 0; i < rounds; i++)
+  {
+    feed.fill(perPoll);
+    ble.poll();
+  }
+  std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+  ble.onScanResult(NULL);
+  if (scanReports != rounds * perPoll)
+  {
+    fprintf(stderr, "scan_cpu: %u reports of %u\n", scanReports,
+            rounds * perPoll);
+    failures++;
+    return;
+  }
+  record("scan_cpu", 100, (unsigned long)(elapsed.count() / scanReports),
+         "ns/report");
+}
+
+static void benchConnect()
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  if (!setUp(module, ble, true)) return;
+  module.addDevice(peerAddress, "peer", -40);
+  unsigned long total = 0;
+  for (unsigned int i = 0; i < config.repeats; i++)
+  {
+    unsigned long start = millis();
+    if (!check(ble.connect(String(peerAddress)), "connect()")) return;
+    total += millis() - start;
+    if (!check(ble.disconnect(), "disconnect()")) return;
+  }
+  record("connect", 0, total / config.repeats, "ms");
+}
+
+// The startup sequence, a step at a time; see benchConfig().
+static BLEMate2::opResult configStep(BLEMate2 &ble, byte step)
+{
+  switch (step)
+  {
+    case 0:  return ble.beginSetParam("ACON", "OFF");
+    case 1:  return ble.beginSetParam("CCON", "OFF");
+    case 2:  return ble.beginStdCmd("ADV OFF");
+    case 3:  return ble.beginSetParam("CENT", "ON");
+    default: return ble.beginWriteConfig();
+  }
+}
+
+// Everything's queued as one batch, waiting for room where it has to, the
+//  way applyConfig() does it. With a depth of 1, that's no faster than
+//  calling the blocking functions one after another.
+static void benchConfig(byte depth)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  if (!setUp(module, ble, false)) return;
+  ble.setPipelineDepth(depth);
+  unsigned long start = millis();
+  ble.beginBatch();
+  for (byte step = 0; step < 5; step++)
+  {
+    BLEMate2::opResult result;
+    while ((result = configStep(ble, step)) == BLEMate2::BUSY_ERROR)
+    {
+      ble.poll();
+    }
+    if (!check(result, "config")) return;
+  }
+  ble.endBatch();
+  if (!check(ble.waitForIdle(), "config")) return;
+  record("config", depth, millis() - start, "ms");
+}
+
+// Central sends go 20 bytes at a time, peripheral ones 125.
+static void benchSend(bool central)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  if (!setUp(module, ble, central)) return;
+  if (central)
+  {
+    module.addDevice(peerAddress, "peer", -40);
+    if (!check(ble.connect(String(peerAddress)), "connect()")) return;
+  }
+  else module.remoteConnect(peerAddress);
+
+  std::string data;
+  for (unsigned int i = 0; i < sendSizes[SEND_SIZES - 1]; i++)
+  {
+    data += (char)('A' + i % 26);
+  }
+  for (unsigned int i = 0; i < SEND_SIZES; i++)
+  {
+    if (!check(ble.sendData(data.c_str(), sendSizes[i]), "sendData()"))
+    {
+      continue;
+    }
+    record(central ? "send_central" : "send_peripheral", sendSizes[i],
+           ble.sendRate(), "bytes/s");
+  }
+}
+
+// One kind of payload, sent repeats times each way; the time is from the
+//  first send to the last OK, and the wire bytes are what the module got in
+//  its SNDs. framer is NULL for raw sends.
+static bool timeSends(BC118Emulator &module, BLEMate2 &ble,
+                      BLEMate2Framer *framer, const byte *data, byte len,
+                      unsigned long &rate, unsigned long &wire)
+{
+  size_t before = module.sent.size();
+  unsigned long start = millis();
+  for (unsigned int i = 0; i < config.repeats; i++)
+  {
+    BLEMate2::opResult result = (framer == NULL) ?
+      ble.sendData((const char *)data, len) : framer->sendFrame(data, len);
+    if (!check(result, framer == NULL ? "sendData()" : "sendFrame()"))
+    {
+      return false;
+    }
+  }
+  unsigned long elapsed = millis() - start;
+  if (elapsed == 0) elapsed = 1;
+  rate = ((unsigned long)len * config.repeats * 1000UL) / elapsed;
+  wire = (module.sent.size() - before) / config.repeats;
+  return true;
+}
+
+// Raw sends can only carry text, so that's what they get, and the framer
+//  gets the same text, to show what framing costs by itself. Binary is what
+//  the framer is for; random bytes need escaping now and then, the way real
+//  data does.
+static void benchFraming()
+{
+  static const byte frameSizes[] = {20, 60, 125, 250};
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  if (!setUp(module, ble, false)) return;
+  module.remoteConnect(peerAddress);
+  BLEMate2Framer framer(&ble);
+
+  byte text[250];
+  byte binary[250];
+  for (unsigned int i = 0; i < sizeof(text); i++)
+  {
+    text[i] = 'A' + i % 26;
+    binary[i] = random(256);
+  }
+  for (unsigned int i = 0; i < sizeof(frameSizes); i++)
+  {
+    byte len = frameSizes[i];
+    unsigned long rate, wire;
+    if (!timeSends(module, ble, NULL, text, len, rate, wire)) return;
+    record("frame_raw", len, rate, "bytes/s");
+    if (!timeSends(module, ble, &framer, text, len, rate, wire)) return;
+    record("frame_text", len, rate, "bytes/s");
+    record("frame_text_overhead", len, (wire - len) * 100 / len, "%");
+    if (!timeSends(module, ble, &framer, binary, len, rate, wire)) return;
+    record("frame_binary", len, rate, "bytes/s");
+    record("frame_binary_overhead", len, (wire - len) * 100 / len, "%");
+  }
+}
+
+// Each module has its own emulator, all of them on the same clock, the way
+//  a gateway would have a UART for each.
+static void benchGroup(byte count)
+{
+  // Reserved up front, since the libraries keep pointers to the emulators
+  //  and the group to the libraries.
+  std::vector<BC118Emulator> modules(count);
+  std::vector<BLEMate2> bles;
+  bles.reserve(count);
+  BLEMate2Group group;
+  char address[13];
+  for (byte i = 0; i < count; i++)
+  {
+    bles.push_back(BLEMate2(&modules[i]));
+    if (!setUp(modules[i], bles[i], false)) return;
+    snprintf(address, sizeof(address), "20FABB0002%02X", i);
+    modules[i].remoteConnect(address);
+    group.add(&bles[i]);
+  }
+  // Give them all a chance to hear about their connections.
+  unsigned long start = millis();
+  while (millis() - start < 100) group.poll();
+
+  std::string data(1000, 'G');
+  if (!check(group.sendAll(data.c_str(), data.size()), "sendAll()")) return;
+  unsigned long slowest = group.sendRate(0);
+  for (byte i = 1; i < count; i++)
+  {
+    if (group.sendRate(i) < slowest) slowest = group.sendRate(i);
+  }
+  record("group_send", count, group.sendRate(), "bytes/s");
+  record("group_send_each", count, slowest, "bytes/s");
+
+  start = millis();
+  for (byte i = 0; i < count; i++)
+  {
+    if (!check(bles[i].sendData(data.c_str(), data.size()), "sendData()"))
+    {
+      return;
+    }
+  }
+  record("group_serial", count,
+         (data.size() * count * 1000UL) / (millis() - start), "bytes/s");
+}
+
+// The emulator allocates as it goes, keeping track of what it's sent and
+//  when, so it's no good for counting the library's allocations. This stands
+//  in for it: it answers each command as soon as it's written, from a fixed
+//  buffer, and STS says we're a peripheral.
+class sink : public Stream
+{
+  public:
+    sink() : _lineLen(0), _head(0), _tail(0) {}
+    int available() { return _tail - _head; }
+    int read() { return (_head < _tail) ? (byte)_answer[_head++] : -1; }
+    int peek() { return (_head < _tail) ? (byte)_answer[_head] : -1; }
+    size_t write(uint8_t c)
+    {
+      if (c != '\r')
+      {
+        if (_lineLen < 3) _line[_lineLen] = c;
+        _lineLen++;
+        return 1;
+      }
+      if (_head == _tail) _head = _tail = 0;
+      if (_lineLen == 3 && memcmp(_line, "STS", 3) == 0) answer("STS P\n\r");
+      answer("OK\n\r");
+      _lineLen = 0;
+      return 1;
+    }
+    using Print::write;
+
+  private:
+    void answer(const char *text)
+    {
+      size_t len = strlen(text);
+      memcpy(&_answer[_tail], text, len);
+      _tail += len;
+    }
+    char _line[3];
+    size_t _lineLen;
+    char _answer[32];
+    size_t _head;
+    size_t _tail;
+};
+
+// The three ways of handing sendData() a buffer: a pointer and a length, a
+//  C string, and a String. The String is made before the counting starts;
+//  what's being measured is what sendData() does with it.
+static BLEMate2::opResult sendFlavour(BLEMate2 &ble, byte flavour,
+                                      const char *data, const String &text,
+                                      size_t len)
+{
+  switch (flavour)
+  {
+    case 0:  return ble.sendData(data, len);
+    case 1:  return ble.sendData(data);
+    default: return ble.sendData(text);
+  }
+}
+
+static void benchSendCost()
+{
+  static const char *const names[] = {"buffer", "cstring", "String"};
+  sink port;
+  BLEMate2 ble(&port);
+  // The first send asks for the role; that's not what we're here for.
+  if (!check(ble.sendData("x"), "sendData()")) return;
+
+  std::string data;
+  for (unsigned int i = 0; i < sendSizes[SEND_SIZES - 1]; i++)
+  {
+    data += (char)('A' + i % 26);
+  }
+  for (unsigned int i = 0; i < SEND_SIZES; i++)
+  {
+    std::string slice(data, 0, sendSizes[i]);
+    String text(slice.c_str());
+    for (byte flavour = 0; flavour < 3; flavour++)
+    {
+      allocs = 0;
+      countingAllocs = true;
+      BLEMate2::opResult result = sendFlavour(ble, flavour, slice.c_str(),
+                                              text, sendSizes[i]);
+      countingAllocs = false;
+      if (!check(result, "sendData()")) return;
+      record((std::string("send_heap_") + names[flavour]).c_str(),
+             sendSizes[i], allocs, "allocs");
+    }
+  }
+
+  // Enough sends to get well clear of the clock's resolution.
+  const unsigned int size = sendSizes[SEND_SIZES - 1];
+  const unsigned int rounds = 200 * config.repeats;
+  std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
+  for (unsigned int i = 0; i < rounds; i++)
+  {
+    if (!check(ble.sendData(data.c_str(), size), "sendData()")) return;
+  }
+  std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+  record("send_cpu", size,
+         (unsigned long)(elapsed.count() / ((long long)rounds * size)),
+         "ns/byte");
+}
+
+static void report()
+{
+  if (!config.json)
+  {
+    printf("test,param,value,unit\n");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+      printf("%s,%u,%lu,%s\n", results[i].test.c_str(), results[i].param,
+             results[i].value, results[i].unit.c_str());
+    }
+    return;
+  }
+
+  // The settings go in too, so a saved run says what it was a run of.
+  printf("{\n  \"baud\": %lu,\n  \"latency\": %ld,\n  \"reset\": %ld,\n"
+         "  \"connect\": %ld,\n  \"repeats\": %u,\n  \"results\": [",
+         config.baud, config.latency, config.resetTime, config.connectTime,
+         config.repeats);
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    printf("%s\n    {\"test\": \"%s\", \"param\": %u, \"value\": %lu, "
+           "\"unit\": \"%s\"}", i > 0 ? "," : "", results[i].test.c_str(),
+           results[i].param, results[i].value, results[i].unit.c_str());
+  }
+  printf("\n  ]\n}\n");
+}
+
+static void usage(const char *name)
+{
+  fprintf(stderr, "usage: %s [--baud N] [--latency MS] [--reset MS] "
+          "[--connect MS] [--repeats N] [--json]\n", name);
+  exit(2);
+}
+
+int main(int argc, char **argv)
+{
+  for (int i = 1; i < argc; i++)
+  {
+    const char *arg = argv[i];
+    if (strcmp(arg, "--json") == 0)
+    {
+      config.json = true;
+      continue;
+    }
+    if (i + 1 >= argc) usage(argv[0]);
+    char *end;
+    long value = strtol(argv[++i], &end, 10);
+    if (*end != '\0' || value < 0) usage(argv[0]);
+    if (strcmp(arg, "--baud") == 0) config.baud = value;
+    else if (strcmp(arg, "--latency") == 0) config.latency = value;
+    else if (strcmp(arg, "--reset") == 0) config.resetTime = value;
+    else if (strcmp(arg, "--connect") == 0) config.connectTime = value;
+    else if (strcmp(arg, "--repeats") == 0 && value > 0)
+    {
+      config.repeats = value;
+    }
+    else usage(argv[0]);
+  }
+
+  randomSeed(1);
+  benchReady();
+  benchCommands();
+  benchScan();
+  benchScanIngest(20);
+  benchScanIngest(50);
+  benchScanIngest(100);
+  benchScanCpu();
+  benchConnect();
+  benchConfig(1);
+  benchConfig(BLE_MATE2_QUEUE_SIZE);
+  benchSend(true);
+  benchSend(false);
+  benchFraming();
+  for (byte count = 1; count <= BLE_MATE2_GROUP_SIZE; count++)
+  {
+    benchGroup(count);
+  }
+  benchSendCost();
+  report();
+  return failures;
+}
@@ -0,0 +1,496 @@
+/****************************************************************
+Just enough of the Arduino core to build the BC118 library on a PC.
+
+See Arduino.h for what this is, and isn't.
+
+This code is beerware; if you use it, please buy me (or any other
+SparkFun employee) a cold beverage next time you run into one of
+us at the local.
+****************************************************************/
+
+#include "Arduino.h"
+#include <ctype.h>
+
+// The linker marks out the flash section for us, since its name is a valid
+//  identifier.
+extern const char __start_host_progmem[];
+extern const char __stop_host_progmem[];
+
+// Every read from flash comes through here. An address outside the section
+//  is a RAM pointer that's been handed to something expecting flash; on an
+//  AVR, that's a read from a flash address that has nothing to do with it.
+const void *hostFlash(const void *p, size_t len)
+{
+  const char *c = (const char *)p;
+  if (c < __start_host_progmem || c + len > __stop_host_progmem)
+  {
+    fprintf(stderr, "flash read from %p, which isn't in flash\n", p);
+    abort();
+  }
+  return p;
+}
+
+size_t strlen_P(const char *s)
+{
+  size_t len = 0;
+  while (pgm_read_byte(s + len) != '\0') len++;
+  return len;
+}
+
+int strcmp_P(const char *a, const char *b)
+{
+  for (;; a++, b++)
+  {
+    byte c = pgm_read_byte(b);
+    if ((byte)*a != c) return (byte)*a - c;
+    if (c == '\0') return 0;
+  }
+}
+
+// strncmp_P() only reads as much of b as it compares, like the real one.
+int strncmp_P(const char *a, const char *b, size_t n)
+{
+  for (; n > 0; n--, a++, b++)
+  {
+    byte c = pgm_read_byte(b);
+    if ((byte)*a != c) return (byte)*a - c;
+    if (c == '\0') return 0;
+  }
+  return 0;
+}
+
+char *strcpy_P(char *dest, const char *src)
+{
+  char *d = dest;
+  while ((*d++ = pgm_read_byte(src++)) != '\0');
+  return dest;
+}
+
+char *strncpy_P(char *dest, const char *src, size_t n)
+{
+  size_t i = 0;
+  for (; i < n && (dest[i] = pgm_read_byte(src + i)) != '\0'; i++);
+  for (; i < n; i++) dest[i] = '\0';
+  return dest;
+}
+
+void *memcpy_P(void *dest, const void *src, size_t n)
+{
+  return memcpy(dest, hostFlash(src, n), n);
+}
+
+// Simulated time, in microseconds. Each look at the clock costs a little, the
+//  way it would on real hardware, so that nothing can spin forever on it.
+static uint64_t now;
+
+unsigned long millis()
+{
+  now += 4;
+  return (unsigned long)(now / 1000);
+}
+
+unsigned long micros()
+{
+  now += 4;
+  return (unsigned long)now;
+}
+
+void delay(unsigned long ms)
+{
+  now += (uint64_t)ms * 1000;
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  now += us;
+}
+
+void hostAdvance(uint64_t us)
+{
+  now += us;
+}
+
+uint64_t hostMicros()
+{
+  return now;
+}
+
+// A little generator of our own, so runs come out the same on every host.
+static unsigned long seed = 1;
+
+long random(long max)
+{
+  if (max <= 0) return 0;
+  seed = seed * 1103515245UL + 12345UL;
+  return (long)((seed >> 16) & 0x7FFF) % max;
+}
+
+long random(long min, long max)
+{
+  if (max <= min) return min;
+  return min + random(max - min);
+}
+
+void randomSeed(unsigned long s)
+{
+  seed = s;
+}
+
+void pinMode(uint8_t, uint8_t)
+{
+}
+
+void digitalWrite(uint8_t, uint8_t)
+{
+}
+
+int digitalRead(uint8_t)
+{
+  return LOW;
+}
+
+static char *formatNumber(unsigned long value, boolean negative, char *text,
+                          int radix)
+{
+  char digits[34];
+  byte n = 0;
+  do
+  {
+    byte d = value % radix;
+    digits[n++] = d < 10 ? '0' + d : 'a' + d - 10;
+    value /= radix;
+  } while (value != 0);
+  char *p = text;
+  if (negative) *p++ = '-';
+  while (n > 0) *p++ = digits[--n];
+  *p = '\0';
+  return text;
+}
+
+char *utoa(unsigned int value, char *text, int radix)
+{
+  return formatNumber(value, false, text, radix);
+}
+
+char *ultoa(unsigned long value, char *text, int radix)
+{
+  return formatNumber(value, false, text, radix);
+}
+
+char *itoa(int value, char *text, int radix)
+{
+  return ltoa(value, text, radix);
+}
+
+char *ltoa(long value, char *text, int radix)
+{
+  if (value < 0 && radix == 10)
+  {
+    return formatNumber(-(unsigned long)value, true, text, radix);
+  }
+  return formatNumber(value, false, text, radix);
+}
+
+String::String(const char *text)
+{
+  if (text != NULL) _s = text;
+}
+
+String::String(const String &other) : _s(other._s)
+{
+}
+
+String::String(const __FlashStringHelper *text)
+{
+  *this = text;
+}
+
+String::String(char c) : _s(1, c)
+{
+}
+
+String::String(int value, unsigned char radix)
+{
+  char text[34];
+  _s = itoa(value, text, radix);
+}
+
+String::String(unsigned int value, unsigned char radix)
+{
+  char text[34];
+  _s = utoa(value, text, radix);
+}
+
+String::String(long value, unsigned char radix)
+{
+  char text[34];
+  _s = ltoa(value, text, radix);
+}
+
+String::String(unsigned long value, unsigned char radix)
+{
+  char text[34];
+  _s = ultoa(value, text, radix);
+}
+
+String &String::operator=(const String &other)
+{
+  _s = other._s;
+  return *this;
+}
+
+String &String::operator=(const char *text)
+{
+  _s = (text != NULL) ? text : "";
+  return *this;
+}
+
+String &String::operator=(const __FlashStringHelper *text)
+{
+  const char *p = (const char *)text;
+  _s.clear();
+  for (char c = pgm_read_byte(p); c != '\0'; c = pgm_read_byte(++p)) _s += c;
+  return *this;
+}
+
+unsigned char String::concat(const String &other)
+{
+  _s += other._s;
+  return 1;
+}
+
+unsigned char String::concat(const char *text)
+{
+  if (text == NULL) return 0;
+  _s += text;
+  return 1;
+}
+
+unsigned char String::concat(char c)
+{
+  _s += c;
+  return 1;
+}
+
+String operator+(const String &a, const String &b)
+{
+  String s(a);
+  s.concat(b);
+  return s;
+}
+
+String operator+(const String &a, const char *b)
+{
+  String s(a);
+  s.concat(b);
+  return s;
+}
+
+String operator+(const char *a, const String &b)
+{
+  String s(a);
+  s.concat(b);
+  return s;
+}
+
+bool String::startsWith(const String &prefix) const
+{
+  return _s.compare(0, prefix._s.size(), prefix._s) == 0;
+}
+
+bool String::endsWith(const String &suffix) const
+{
+  return _s.size() >= suffix._s.size() &&
+         _s.compare(_s.size() - suffix._s.size(), suffix._s.size(),
+                    suffix._s) == 0;
+}
+
+char String::charAt(unsigned int index) const
+{
+  return (index < _s.size()) ? _s[index] : '\0';
+}
+
+int String::indexOf(char c) const
+{
+  size_t pos = _s.find(c);
+  return (pos == std::string::npos) ? -1 : (int)pos;
+}
+
+int String::indexOf(const String &text) const
+{
+  size_t pos = _s.find(text._s);
+  return (pos == std::string::npos) ? -1 : (int)pos;
+}
+
+String String::substring(unsigned int from) const
+{
+  return substring(from, _s.size());
+}
+
+String String::substring(unsigned int from, unsigned int to) const
+{
+  if (to > _s.size()) to = _s.size();
+  String s;
+  if (from < to) s._s = _s.substr(from, to - from);
+  return s;
+}
+
+void String::toCharArray(char *buffer, unsigned int size) const
+{
+  if (size == 0) return;
+  size_t len = _s.copy(buffer, size - 1);
+  buffer[len] = '\0';
+}
+
+long String::toInt() const
+{
+  return atol(_s.c_str());
+}
+
+void String::trim()
+{
+  size_t first = 0;
+  while (first < _s.size() && isspace((byte)_s[first])) first++;
+  size_t last = _s.size();
+  while (last > first && isspace((byte)_s[last - 1])) last--;
+  _s = _s.substr(first, last - first);
+}
+
+void String::remove(unsigned int index)
+{
+  if (index < _s.size()) _s.erase(index);
+}
+
+void String::remove(unsigned int index, unsigned int count)
+{
+  if (index < _s.size()) _s.erase(index, count);
+}
+
+unsigned char String::reserve(unsigned int size)
+{
+  _s.reserve(size);
+  return 1;
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+  size_t n = 0;
+  while (size-- > 0) n += write(*buffer++);
+  return n;
+}
+
+size_t Print::write(const char *text)
+{
+  return write((const uint8_t *)text, strlen(text));
+}
+
+size_t Print::write(const char *buffer, size_t size)
+{
+  return write((const uint8_t *)buffer, size);
+}
+
+size_t Print::print(const __FlashStringHelper *text)
+{
+  const char *p = (const char *)text;
+  size_t n = 0;
+  for (byte c = pgm_read_byte(p); c != '\0'; c = pgm_read_byte(++p))
+  {
+    n += write(c);
+  }
+  return n;
+}
+
+size_t Print::print(const String &text)
+{
+  return write(text.c_str(), text.length());
+}
+
+size_t Print::print(const char *text)
+{
+  return write(text);
+}
+
+size_t Print::print(char c)
+{
+  return write((uint8_t)c);
+}
+
+size_t Print::print(unsigned char value, int base)
+{
+  return print((unsigned long)value, base);
+}
+
+size_t Print::print(int value, int base)
+{
+  return print((long)value, base);
+}
+
+size_t Print::print(unsigned int value, int base)
+{
+  return print((unsigned long)value, base);
+}
+
+// Like the real thing, only base 10 gets a minus sign; anything else prints
+//  the two's complement.
+size_t Print::print(long value, int base)
+{
+  char text[34];
+  if (base == 10) return print(ltoa(value, text, 10));
+  return print((unsigned long)value, base);
+}
+
+size_t Print::print(unsigned long value, int base)
+{
+  char text[34];
+  ultoa(value, text, base);
+  if (base == HEX)
+  {
+    for (char *p = text; *p != '\0'; p++)
+    {
+      if (*p >= 'a') *p -= 'a' - 'A';
+    }
+  }
+  return print(text);
+}
+
+size_t Print::print(double value, int digits)
+{
+  char text[40];
+  snprintf(text, sizeof(text), "%.*f", digits, value);
+  return print(text);
+}
+
+size_t Print::println()
+{
+  return write("\r\n");
+}
+
+HardwareSerial Serial;
+
+void HardwareSerial::begin(unsigned long)
+{
+}
+
+void HardwareSerial::end()
+{
+}
+
+int HardwareSerial::available()
+{
+  return 0;
+}
+
+int HardwareSerial::read()
+{
+  return -1;
+}
+
+int HardwareSerial::peek()
+{
+  return -1;
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+  return fputc(c, stdout) == EOF ? 0 : 1;
+}
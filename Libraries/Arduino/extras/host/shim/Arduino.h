@@ -0,0 +1,202 @@
+/****************************************************************
+Just enough of the Arduino core to build the BC118 library on a PC.
+
+This isn't the real core, and it doesn't try to be: it has what the
+library, its tests and its benchmarks use, done the simple way. Two
+things about it matter more than the rest.
+
+Time is simulated. millis() doesn't look at a clock; it reads a
+counter that delay() moves along, that the emulator moves along as
+bytes cross the serial link, and that creeps forward a little every
+time anybody asks, so a loop that spins on millis() still gets
+somewhere. A test that takes ten simulated seconds runs in a few
+milliseconds, and runs the same way every time.
+
+Flash is checked. On an AVR, flash and RAM are separate address
+spaces, and a pointer to one read as the other reads garbage without
+complaint. Here, everything marked PROGMEM (and every PSTR() and
+F() string) goes into a section of its own, and every pgm_read_*()
+and *_P() function makes sure the address it's handed is in it. Hand
+one of them a RAM pointer and the test run stops right there,
+rather than the mistake waiting for the first AVR to find it.
+
+This code is beerware; if you use it, please buy me (or any other
+SparkFun employee) a cold beverage next time you run into one of
+us at the local.
+****************************************************************/
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <string>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+
+#define DEC 10
+#define HEX 16
+
+// Flash. See the top of the file.
+#define PROGMEM __attribute__((section("host_progmem")))
+#define PSTR(s) (__extension__({static const char __pstr[] PROGMEM = (s); \
+                                &__pstr[0];}))
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(PSTR(s)))
+
+const void *hostFlash(const void *p, size_t len);
+#define pgm_read_byte(p) (*(const uint8_t *)hostFlash((p), 1))
+#define pgm_read_word(p) (*(const uint16_t *)hostFlash((p), 2))
+#define pgm_read_dword(p) (*(const uint32_t *)hostFlash((p), 4))
+
+size_t strlen_P(const char *s);
+int strcmp_P(const char *a, const char *b);
+int strncmp_P(const char *a, const char *b, size_t n);
+char *strcpy_P(char *dest, const char *src);
+char *strncpy_P(char *dest, const char *src, size_t n);
+void *memcpy_P(void *dest, const void *src, size_t n);
+
+// Time. See the top of the file; hostAdvance() and hostMicros() are for the
+//  emulator and the tests.
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void hostAdvance(uint64_t us);
+uint64_t hostMicros();
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+// Pins don't do anything, but the example sketches use them.
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+char *utoa(unsigned int value, char *text, int radix);
+char *itoa(int value, char *text, int radix);
+char *ultoa(unsigned long value, char *text, int radix);
+char *ltoa(long value, char *text, int radix);
+
+class String
+{
+  public:
+    String(const char *text = "");
+    String(const String &other);
+    String(const __FlashStringHelper *text);
+    explicit String(char c);
+    explicit String(int value, unsigned char radix = DEC);
+    explicit String(unsigned int value, unsigned char radix = DEC);
+    explicit String(long value, unsigned char radix = DEC);
+    explicit String(unsigned long value, unsigned char radix = DEC);
+
+    String &operator=(const String &other);
+    String &operator=(const char *text);
+    String &operator=(const __FlashStringHelper *text);
+
+    unsigned char concat(const String &other);
+    unsigned char concat(const char *text);
+    unsigned char concat(char c);
+    String &operator+=(const String &other) { concat(other); return *this; }
+    String &operator+=(const char *text) { concat(text); return *this; }
+    String &operator+=(char c) { concat(c); return *this; }
+    friend String operator+(const String &a, const String &b);
+    friend String operator+(const String &a, const char *b);
+    friend String operator+(const char *a, const String &b);
+
+    bool operator==(const String &other) const { return _s == other._s; }
+    bool operator==(const char *text) const { return _s == text; }
+    bool operator!=(const String &other) const { return _s != other._s; }
+    bool operator!=(const char *text) const { return _s != text; }
+    bool equals(const String &other) const { return _s == other._s; }
+    bool startsWith(const String &prefix) const;
+    bool endsWith(const String &suffix) const;
+
+    unsigned int length() const { return _s.size(); }
+    const char *c_str() const { return _s.c_str(); }
+    char charAt(unsigned int index) const;
+    char operator[](unsigned int index) const { return charAt(index); }
+    int indexOf(char c) const;
+    int indexOf(const String &text) const;
+    String substring(unsigned int from) const;
+    String substring(unsigned int from, unsigned int to) const;
+    void toCharArray(char *buffer, unsigned int size) const;
+    long toInt() const;
+    void trim();
+    void remove(unsigned int index);
+    void remove(unsigned int index, unsigned int count);
+    unsigned char reserve(unsigned int size);
+
+  private:
+    std::string _s;
+};
+
+class Print
+{
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    size_t write(const char *text);
+    size_t write(const char *buffer, size_t size);
+    virtual void flush() {}
+
+    size_t print(const __FlashStringHelper *text);
+    size_t print(const String &text);
+    size_t print(const char *text);
+    size_t print(char c);
+    size_t print(unsigned char value, int base = DEC);
+    size_t print(int value, int base = DEC);
+    size_t print(unsigned int value, int base = DEC);
+    size_t print(long value, int base = DEC);
+    size_t print(unsigned long value, int base = DEC);
+    size_t print(double value, int digits = 2);
+
+    size_t println();
+    template <class T> size_t println(T value)
+    {
+      size_t n = print(value);
+      return n + println();
+    }
+    template <class T> size_t println(T value, int base)
+    {
+      size_t n = print(value, base);
+      return n + println();
+    }
+};
+
+class Stream : public Print
+{
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+// The sketches' Serial. What's printed to it goes to stdout; it never has
+//  anything to read.
+class HardwareSerial : public Stream
+{
+  public:
+    void begin(unsigned long baud);
+    void end();
+    int available();
+    int read();
+    int peek();
+    size_t write(uint8_t c);
+    using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+#endif
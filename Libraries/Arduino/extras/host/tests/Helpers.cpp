@@ -0,0 +1,18 @@
+/****************************************************************
+Things most of the host tests need.
+
+This code is beerware; if you use it, please buy me (or any other
+SparkFun employee) a cold beverage next time you run into one of
+us at the local.
+****************************************************************/
+
+#include "Helpers.h"
+
+resultLog completed;
+
+void logResult(BLEMate2::opResult result)
+{
+  const byte size = sizeof(completed.results) / sizeof(completed.results[0]);
+  if (completed.count < size) completed.results[completed.count] = result;
+  completed.count++;
+}
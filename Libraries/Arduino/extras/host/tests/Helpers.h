@@ -0,0 +1,68 @@
+/****************************************************************
+Things most of the host tests need.
+
+This code is beerware; if you use it, please buy me (or any other
+SparkFun employee) a cold beverage next time you run into one of
+us at the local.
+****************************************************************/
+
+#ifndef Helpers_h
+#define Helpers_h
+
+#include "HostTest.h"
+#include "BC118Emulator.h"
+#include <SparkFunBLEMate2.h>
+
+// Keep the library turning for a while.
+inline void pollFor(BLEMate2 &ble, unsigned long ms)
+{
+  unsigned long start = millis();
+  while (millis() - start < ms) ble.poll();
+}
+
+// How many commands starting with prefix the module has seen, from the
+//  from'th on.
+inline unsigned int countCommands(BC118Emulator &module, const char *prefix,
+                                  size_t from = 0)
+{
+  unsigned int n = 0;
+  for (size_t i = from; i < module.commands.size(); i++)
+  {
+    if (module.commands[i].compare(0, strlen(prefix), prefix) == 0) n++;
+  }
+  return n;
+}
+
+// A module that's been reset into central mode, the way a sketch would do
+//  it: the setting, a write and a reset.
+inline void becomeCentral(BLEMate2 &ble)
+{
+  ble.reset();
+  ble.BLECentral();
+  ble.writeConfig();
+  ble.reset();
+}
+
+// Somewhere to print to, for a look at what came out afterwards.
+class captured : public Print
+{
+  public:
+    std::string text;
+    size_t write(uint8_t c)
+    {
+      text += (char)c;
+      return 1;
+    }
+    using Print::write;
+};
+
+// Results from onComplete(), in order.
+struct resultLog
+{
+  BLEMate2::opResult results[16];
+  byte count;
+};
+extern resultLog completed;
+void logResult(BLEMate2::opResult result);
+
+#endif
@@ -0,0 +1,48 @@
+/****************************************************************
+A very small test framework for the host build.
+
+Each TEST() is a function that registers itself; the runner in
+main.cpp calls them in the order they appear, file by file. The
+CHECK macros note a failure and carry on, so one run shows
+everything that's wrong with a test, not just the first thing.
+
+This code is beerware; if you use it, please buy me (or any other
+SparkFun employee) a cold beverage next time you run into one of
+us at the local.
+****************************************************************/
+
+#ifndef HostTest_h
+#define HostTest_h
+
+#include <Arduino.h>
+#include <string>
+
+struct HostTest
+{
+  HostTest(const char *name, void (*function)());
+  const char *name;
+  void (*function)();
+  HostTest *next;
+};
+
+#define TEST(name) \
+  static void name(); \
+  static HostTest name##Test(#name, name); \
+  static void name()
+
+#define CHECK(condition) \
+  hostCheck((condition), #condition, __FILE__, __LINE__)
+#define CHECK_EQUAL(expected, actual) \
+  hostCheckEqual((long)(expected), (long)(actual), #actual, __FILE__, __LINE__)
+#define CHECK_STRING(expected, actual) \
+  hostCheckString((expected), (actual), #actual, __FILE__, __LINE__)
+
+void hostCheck(bool ok, const char *what, const char *file, int line);
+void hostCheckEqual(long expected, long actual, const char *what,
+                    const char *file, int line);
+void hostCheckString(const std::string &expected, const std::string &actual,
+                     const char *what, const char *file, int line);
+void hostCheckString(const std::string &expected, const String &actual,
+                     const char *what, const char *file, int line);
+
+#endif
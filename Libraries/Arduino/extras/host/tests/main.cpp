@@ -0,0 +1,90 @@
+/****************************************************************
+Runs the host tests.
+
+With no arguments, every test runs; otherwise, only the tests whose
+names contain one of the arguments. The exit status is the number of
+tests that failed.
+
+This code is beerware; if you use it, please buy me (or any other
+SparkFun employee) a cold beverage next time you run into one of
+us at the local.
+****************************************************************/
+
+#include "HostTest.h"
+
+static HostTest *first = NULL;
+static HostTest *last = NULL;
+static unsigned int failures;
+
+HostTest::HostTest(const char *name, void (*function)())
+{
+  this->name = name;
+  this->function = function;
+  next = NULL;
+  if (last != NULL) last->next = this;
+  else first = this;
+  last = this;
+}
+
+void hostCheck(bool ok, const char *what, const char *file, int line)
+{
+  if (ok) return;
+  failures++;
+  printf("  %s:%d: CHECK(%s) failed\n", file, line, what);
+}
+
+void hostCheckEqual(long expected, long actual, const char *what,
+                    const char *file, int line)
+{
+  if (expected == actual) return;
+  failures++;
+  printf("  %s:%d: %s is %ld, expected %ld\n", file, line, what, actual,
+         expected);
+}
+
+void hostCheckString(const std::string &expected, const std::string &actual,
+                     const char *what, const char *file, int line)
+{
+  if (expected == actual) return;
+  failures++;
+  printf("  %s:%d: %s is \"%s\", expected \"%s\"\n", file, line, what,
+         actual.c_str(), expected.c_str());
+}
+
+void hostCheckString(const std::string &expected, const String &actual,
+                     const char *what, const char *file, int line)
+{
+  hostCheckString(expected, std::string(actual.c_str()), what, file, line);
+}
+
+static bool selected(const char *name, int argc, char **argv)
+{
+  if (argc < 2) return true;
+  for (int i = 1; i < argc; i++)
+  {
+    if (strstr(name, argv[i]) != NULL) return true;
+  }
+  return false;
+}
+
+int main(int argc, char **argv)
+{
+  int failed = 0;
+  int run = 0;
+  for (HostTest *t = first; t != NULL; t = t->next)
+  {
+    if (!selected(t->name, argc, argv)) continue;
+    randomSeed(1);
+    failures = 0;
+    t->function();
+    run++;
+    if (failures == 0) printf("ok   %s\n", t->name);
+    else
+    {
+      printf("FAIL %s\n", t->name);
+      failed++;
+    }
+  }
+  printf("%d tests, %d failed\n", run, failed);
+  return failed;
+}
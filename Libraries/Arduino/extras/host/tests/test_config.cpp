@@ -0,0 +1,206 @@
+/****************************************************************
+Reading and writing the module's settings.
+
+This code is beerware; if you use it, please buy me (or any other
+SparkFun employee) a cold beverage next time you run into one of
+us at the local.
+****************************************************************/
+
+#include "Helpers.h"
+
+// The value comes back on a line that starts with the name; all three
+//  flavors of name should find it.
+TEST(getParam)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  String value;
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.stdGetParam("NAME", value));
+  CHECK_STRING("BC118", value);
+  value = "";
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.stdGetParam(F("ACON"), value));
+  CHECK_STRING("ON", value);
+  value = "";
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.stdGetParam(String("UART"), value));
+  CHECK_STRING("0028", value);
+  CHECK_EQUAL(BLEMate2::MODULE_ERROR, ble.stdGetParam("NOPE", value));
+}
+
+TEST(readConfig)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  BLEMate2Config config;
+  memset(&config, 0x55, sizeof(config));
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.readConfig(config));
+  CHECK_EQUAL(9600, config.baudRate);
+  CHECK(!config.central);
+  CHECK(config.autoConnect);
+  CHECK(config.advertiseOnDisconnect);
+  CHECK_EQUAL(0, config.scanTimeout);
+  CHECK(config.fastAdvertising);
+  CHECK_EQUAL(0, config.advertiseTimeout);
+  CHECK_STRING("BC118", std::string(config.name));
+}
+
+// fastBegin() only sends what's different, and only resets if it has to.
+TEST(fastBegin)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  BLEMate2Config desired;
+  ble.readConfig(desired);
+  desired.central = true;
+  strcpy(desired.name, "bench");
+  size_t from = module.commands.size();
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.fastBegin(desired));
+  CHECK_EQUAL(2, countCommands(module, "SET ", from));
+  CHECK_EQUAL(1, countCommands(module, "WRT", from));
+  CHECK_EQUAL(1, countCommands(module, "RST", from));
+  CHECK(module.central());
+  CHECK_STRING("bench", module.stored("NAME"));
+
+  from = module.commands.size();
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.fastBegin(desired));
+  CHECK_EQUAL(BLEMate2::CONFIG_FIELDS, countCommands(module, "GET ", from));
+  CHECK_EQUAL(BLEMate2::CONFIG_FIELDS, module.commands.size() - from);
+}
+
+static BC118Emulator *baudModule;
+
+static void setHostBaud(unsigned long baud)
+{
+  baudModule->setHostBaud(baud);
+}
+
+// autoBaud() finds the module wherever it is, and then moves both ends up
+//  to the fastest rate that works.
+TEST(autoBaud)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  baudModule = &module;
+  module.setHostBaud(57600);
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.autoBaud(setHostBaud, 115200));
+  CHECK_EQUAL(115200, module.moduleBaud());
+  CHECK_EQUAL(115200, module.hostBaud());
+  CHECK_EQUAL(115200, ble.getBaudRate());
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.stdCmd("ADV OFF"));
+}
+
+// An ERR partway through applyConfig() stops everything behind it: no more
+//  SETs, no WRT and no RST, and current still says what the module has.
+TEST(applyConfigStopsOnError)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  BLEMate2Config current;
+  ble.readConfig(current);
+  BLEMate2Config desired = current;
+  desired.central = true;
+  desired.autoConnect = false;
+  desired.advertiseOnDisconnect = false;
+  desired.scanTimeout = 5;
+  desired.fastAdvertising = false;
+  desired.advertiseTimeout = 30;
+  strcpy(desired.name, "bench");
+  module.failNext("SET CENT");
+  size_t from = module.commands.size();
+  CHECK_EQUAL(BLEMate2::MODULE_ERROR, ble.applyConfig(desired, current));
+  CHECK_EQUAL(0, countCommands(module, "WRT", from));
+  CHECK_EQUAL(0, countCommands(module, "RST", from));
+  CHECK(!current.central);
+  CHECK_STRING("BC118", std::string(current.name));
+  CHECK_STRING("BC118", module.stored("NAME"));
+
+  // Whatever was already on the wire went through, but nothing was
+  //  sent after the ERR came back.
+  CHECK_STRING("SET CENT=ON", module.commands[from]);
+  CHECK_EQUAL(BLE_MATE2_QUEUE_SIZE, countCommands(module, "SET ", from));
+
+  // And it all goes through once the module stops complaining.
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.applyConfig(desired, current));
+  CHECK(current.central);
+  CHECK_STRING("bench", module.stored("NAME"));
+  CHECK(module.central());
+}
+
+// Same for reading: a GET that fails takes the rest of them with it.
+TEST(readConfigStopsOnError)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  module.failNext("GET ACON");
+  BLEMate2Config config;
+  strcpy(config.name, "unset");
+  size_t from = module.commands.size();
+  CHECK_EQUAL(BLEMate2::MODULE_ERROR, ble.readConfig(config));
+  CHECK(countCommands(module, "GET ", from) < BLEMate2::CONFIG_FIELDS);
+  CHECK_EQUAL(0, countCommands(module, "GET NAME", from));
+  CHECK_STRING("unset", std::string(config.name));
+}
+
+// newCommand() hears the module out before it takes a slot, and a callback
+//  in there can fill the queue. readConfig() and applyConfig() have to give
+//  up cleanly when that happens, not build a command in a slot they didn't
+//  get. The module takes its time over the commands that fill the queue, so
+//  they're still there when the callback returns.
+static BLEMate2 *crowded;
+static unsigned int crowdedBy;
+
+static void fillQueue()
+{
+  while (crowded->beginStdCmd("ADV OFF") == BLEMate2::SUCCESS) crowdedBy++;
+}
+
+TEST(readConfigQueueFilled)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  crowded = &ble;
+  crowdedBy = 0;
+  ble.onConnect(fillQueue);
+  module.setLatency("ADV", 500);
+  module.remoteConnect("20FABB0000FF");
+  delay(50);
+  BLEMate2Config config;
+  strcpy(config.name, "unset");
+  size_t from = module.commands.size();
+  CHECK_EQUAL(BLEMate2::BUSY_ERROR, ble.readConfig(config));
+  CHECK_EQUAL(BLE_MATE2_QUEUE_SIZE, crowdedBy);
+  CHECK(!ble.busy());
+  CHECK_EQUAL(0, countCommands(module, "GET ", from));
+  CHECK_STRING("unset", std::string(config.name));
+  ble.onConnect(NULL);
+}
+
+TEST(applyConfigQueueFilled)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  BLEMate2Config current;
+  ble.readConfig(current);
+  BLEMate2Config desired = current;
+  strcpy(desired.name, "bench");
+  crowded = &ble;
+  crowdedBy = 0;
+  ble.onConnect(fillQueue);
+  module.setLatency("ADV", 500);
+  module.remoteConnect("20FABB0000FF");
+  delay(50);
+  size_t from = module.commands.size();
+  CHECK_EQUAL(BLEMate2::BUSY_ERROR, ble.applyConfig(desired, current));
+  CHECK_EQUAL(BLE_MATE2_QUEUE_SIZE, crowdedBy);
+  CHECK_EQUAL(0, countCommands(module, "SET ", from));
+  CHECK_EQUAL(0, countCommands(module, "WRT", from));
+  CHECK_STRING("BC118", std::string(current.name));
+  ble.onConnect(NULL);
+  ble.waitForIdle();
+}
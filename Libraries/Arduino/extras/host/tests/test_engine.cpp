@@ -0,0 +1,406 @@
+/****************************************************************
+The command engine: resyncs, the queue, pipelining and batches.
+
+This code is beerware; if you use it, please buy me (or any other
+SparkFun employee) a cold beverage next time you run into one of
+us at the local.
+****************************************************************/
+
+#include "Helpers.h"
+
+// We don't know what state the module's in to begin with, so the very first
+//  thing on the wire is a bare "\r"; after that, the reset goes straight out
+//  and is followed up with "SCN OFF".
+TEST(resetSyncsFirst)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.reset());
+  CHECK_EQUAL(3, module.commands.size());
+  CHECK_STRING("", module.commands[0]);
+  CHECK_STRING("RST", module.commands[1]);
+  CHECK_STRING("SCN OFF", module.commands[2]);
+  CHECK_EQUAL(1, ble.resyncCount());
+  CHECK_EQUAL(1, module.resets);
+}
+
+// Once we're in step with the module, commands go out one after another
+//  with nothing in between.
+TEST(noResyncWhileInStep)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  size_t from = module.commands.size();
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.stdSetParam("ACON", "OFF"));
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.stdSetParam(F("CCON"), F("OFF")));
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.stdCmd(String("ADV OFF")));
+  CHECK_EQUAL(from + 3, module.commands.size());
+  CHECK_EQUAL(1, ble.resyncCount());
+  CHECK_STRING("OFF", module.param("ACON"));
+  CHECK_STRING("OFF", module.param("CCON"));
+}
+
+// A timeout means we've lost track of the module, so the next command gets
+//  a resync in front of it.
+TEST(timeoutResyncs)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  module.setDeaf(true);
+  unsigned long start = millis();
+  CHECK_EQUAL(BLEMate2::TIMEOUT_ERROR, ble.stdCmd("ADV OFF"));
+  CHECK(millis() - start >= 3000);
+  module.setDeaf(false);
+  size_t from = module.commands.size();
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.stdCmd("ADV OFF"));
+  CHECK_EQUAL(2, ble.resyncCount());
+  CHECK_EQUAL(from + 2, module.commands.size());
+  CHECK_STRING("", module.commands[from]);
+}
+
+// The answer to a command that timed out still turns up, after the resync
+//  has started. It mustn't be taken for the answer to the resync, or every
+//  answer after it is matched up with the wrong command.
+TEST(lateAnswerDuringResync)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  ble.setDeadline(BLEMate2::CMD_STD, 60);
+  module.setLatency("SET ACON", 150);
+  module.failNext("SET ACON");
+  CHECK_EQUAL(BLEMate2::TIMEOUT_ERROR, ble.stdSetParam("ACON", "OFF"));
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.stdCmd("ADV OFF"));
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.stdSetParam("CCON", "OFF"));
+  module.failNext("SET SCNT");
+  CHECK_EQUAL(BLEMate2::MODULE_ERROR, ble.stdSetParam("SCNT", "5"));
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.stdSetParam("SCNT", "6"));
+  CHECK_EQUAL(2, ble.resyncCount());
+  CHECK_STRING("OFF", module.param("CCON"));
+  CHECK_STRING("6", module.param("SCNT"));
+
+  // The same goes for everything that was on the wire behind it.
+  module.failNext("SET ACON");
+  ble.beginSetParam("ACON", "OFF");
+  ble.beginSetParam("CCON", "ON");
+  ble.beginStdCmd("ADV OFF");
+  ble.waitForIdle();
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.stdSetParam("SCNT", "7"));
+  module.failNext("SET SCNT");
+  CHECK_EQUAL(BLEMate2::MODULE_ERROR, ble.stdSetParam("SCNT", "8"));
+  CHECK_EQUAL(3, ble.resyncCount());
+  CHECK_STRING("7", module.param("SCNT"));
+}
+
+// If the resync never gets its ERR, the command goes out anyway after a
+//  quiet second. When that works out, the module's back in step, and the
+//  commands queued behind it go out and get their own answers.
+TEST(resyncFallback)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  module.setDeaf(true);
+  CHECK_EQUAL(BLEMate2::TIMEOUT_ERROR, ble.stdCmd("ADV OFF"));
+  completed.count = 0;
+  ble.onComplete(logResult);
+  ble.beginSetParam("NAME", "a");
+  ble.beginSetParam("ACON", "OFF");
+  ble.beginSetParam("CCON", "OFF");
+  pollFor(ble, 500);
+  module.setDeaf(false);
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.waitForIdle());
+  CHECK_EQUAL(3, completed.count);
+  CHECK_EQUAL(BLEMate2::SUCCESS, completed.results[0]);
+  CHECK_EQUAL(BLEMate2::SUCCESS, completed.results[1]);
+  CHECK_EQUAL(BLEMate2::SUCCESS, completed.results[2]);
+  CHECK_STRING("a", module.param("NAME"));
+  CHECK_STRING("OFF", module.param("ACON"));
+  CHECK_STRING("OFF", module.param("CCON"));
+  ble.onComplete(NULL);
+
+  // And no resync in front of the next one.
+  unsigned int resyncs = ble.resyncCount();
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.stdCmd("ADV OFF"));
+  CHECK_EQUAL(resyncs, ble.resyncCount());
+}
+
+// So does a line too long to make sense of.
+TEST(longLineResyncs)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  module.sayLine(std::string(BLE_MATE2_LINE_SIZE + 10, 'x').c_str());
+  pollFor(ble, 500);
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.stdCmd("ADV OFF"));
+  CHECK_EQUAL(2, ble.resyncCount());
+}
+
+// The begin*() functions return as soon as the command's queued; poll()
+//  does the rest.
+TEST(nonBlocking)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  completed.count = 0;
+  ble.onComplete(logResult);
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.beginStdCmd(F("ADV OFF")));
+  CHECK(ble.busy());
+  CHECK_EQUAL(BLEMate2::IN_PROGRESS, ble.lastResult());
+  while (ble.busy()) ble.poll();
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.lastResult());
+  CHECK_EQUAL(1, completed.count);
+  CHECK_EQUAL(BLEMate2::SUCCESS, completed.results[0]);
+  ble.onComplete(NULL);
+}
+
+// A full queue turns away begin*() calls rather than waiting.
+TEST(queueFull)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  for (byte i = 0; i < BLE_MATE2_QUEUE_SIZE; i++)
+  {
+    CHECK_EQUAL(BLEMate2::SUCCESS, ble.beginStdCmd("ADV OFF"));
+  }
+  CHECK_EQUAL(BLEMate2::BUSY_ERROR, ble.beginStdCmd("ADV OFF"));
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.waitForIdle());
+}
+
+// Simple commands go out together, and the answers are matched up with
+//  them in order.
+TEST(pipelining)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  module.setLatency(20);
+  size_t from = module.commands.size();
+  ble.beginSetParam("ACON", "OFF");
+  ble.beginSetParam("CCON", "OFF");
+  ble.beginStdCmd("ADV OFF");
+  ble.beginSetParam("SCNT", "5");
+  CHECK_EQUAL(from + 4, module.commands.size());
+  unsigned long start = millis();
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.waitForIdle());
+  unsigned long pipelined = millis() - start;
+
+  ble.setPipelineDepth(1);
+  start = millis();
+  ble.beginSetParam("ACON", "ON");
+  ble.beginSetParam("CCON", "ON");
+  ble.beginStdCmd("ADV OFF");
+  ble.beginSetParam("SCNT", "0");
+  CHECK_EQUAL(from + 5, module.commands.size());
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.waitForIdle());
+  unsigned long serial = millis() - start;
+  CHECK(pipelined * 2 < serial);
+  CHECK_STRING("0", module.param("SCNT"));
+}
+
+// A failure in a batch stops what's left of it from going out.
+TEST(batchStopsOnFailure)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  ble.setPipelineDepth(1);
+  module.failNext("SET CCON");
+  completed.count = 0;
+  ble.onComplete(logResult);
+  ble.beginBatch();
+  ble.beginSetParam("ACON", "OFF");
+  ble.beginSetParam("CCON", "OFF");
+  ble.beginStdCmd("ADV OFF");
+  ble.beginSetParam("CENT", "ON");
+  ble.endBatch();
+  CHECK_EQUAL(BLEMate2::MODULE_ERROR, ble.waitForIdle());
+  ble.onComplete(NULL);
+  CHECK_EQUAL(4, completed.count);
+  CHECK_EQUAL(BLEMate2::SUCCESS, completed.results[0]);
+  CHECK_EQUAL(BLEMate2::MODULE_ERROR, completed.results[1]);
+  CHECK_EQUAL(BLEMate2::ABORTED_ERROR, completed.results[2]);
+  CHECK_EQUAL(BLEMate2::ABORTED_ERROR, completed.results[3]);
+  CHECK_EQUAL(0, countCommands(module, "ADV"));
+  CHECK_STRING("OFF", module.param("CENT"));
+
+  // And the next command isn't part of it.
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.stdCmd("ADV OFF"));
+}
+
+// Commands that were already on the wire when a batch member failed get
+//  their own answers; the ones queued after the failure don't go out at all,
+//  even if the queue emptied out in between, and the failure sticks until
+//  the batch is over.
+TEST(batchFailureSticks)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  module.failNext("SET CCON");
+  completed.count = 0;
+  ble.onComplete(logResult);
+  size_t from = module.commands.size();
+  ble.beginBatch();
+  ble.beginSetParam("ACON", "OFF");
+  ble.beginSetParam("CCON", "OFF");
+  ble.beginSetParam("SCNT", "5");
+  while (ble.busy()) ble.poll();
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.beginSetParam("CENT", "ON"));
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.beginStdCmd("ADV OFF"));
+  ble.endBatch();
+  CHECK_EQUAL(BLEMate2::MODULE_ERROR, ble.waitForIdle());
+  ble.onComplete(NULL);
+  CHECK_EQUAL(5, completed.count);
+  CHECK_EQUAL(BLEMate2::SUCCESS, completed.results[0]);
+  CHECK_EQUAL(BLEMate2::MODULE_ERROR, completed.results[1]);
+  CHECK_EQUAL(BLEMate2::SUCCESS, completed.results[2]);
+  CHECK_EQUAL(BLEMate2::ABORTED_ERROR, completed.results[3]);
+  CHECK_EQUAL(BLEMate2::ABORTED_ERROR, completed.results[4]);
+  CHECK_EQUAL(3, module.commands.size() - from);
+  CHECK_STRING("OFF", module.param("CENT"));
+  CHECK_STRING("5", module.param("SCNT"));
+
+  // The next batch starts with a clean slate.
+  ble.beginBatch();
+  ble.beginSetParam("CCON", "OFF");
+  ble.endBatch();
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.waitForIdle());
+}
+
+// Events show up in the middle of commands all the time; they mustn't be
+//  taken for answers.
+TEST(eventsDuringCommands)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  module.remoteConnect("20FABB0000FF");
+  module.setLatency(30);
+  ble.beginStdCmd("ADV OFF");
+  module.remoteSend("hello");
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.waitForIdle());
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.connectionState());
+  char buffer[8];
+  CHECK_EQUAL(5, ble.read(buffer, sizeof(buffer)));
+  CHECK(memcmp(buffer, "hello", 5) == 0);
+  CHECK_EQUAL(1, ble.resyncCount());
+}
+
+// Data that doesn't fit in the receive buffer is dropped and counted; what
+//  did fit comes out in order, and peek() only looks. Once there's room
+//  again, data goes in as before, around the end of the buffer.
+TEST(receiveOverflow)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  module.remoteConnect("20FABB0000FF");
+  pollFor(ble, 50);
+  std::string first, second;
+  for (unsigned int i = 0; i < BLE_MATE2_RX_SIZE - 10; i++)
+  {
+    first += (char)('A' + i % 26);
+  }
+  for (unsigned int i = 0; i < 30; i++)
+  {
+    second += (char)('a' + i % 26);
+  }
+  module.remoteSend(first.c_str());
+  module.remoteSend(second.c_str());
+  pollFor(ble, 200);
+  CHECK_EQUAL(BLE_MATE2_RX_SIZE, ble.available());
+  CHECK_EQUAL(20, ble.rxOverflowCount());
+
+  CHECK_EQUAL('A', ble.peek());
+  CHECK_EQUAL('A', ble.peek());
+  CHECK_EQUAL(BLE_MATE2_RX_SIZE, ble.available());
+  std::string kept = first + second.substr(0, 10);
+  std::string got;
+  int c;
+  while ((c = ble.read()) >= 0) got += (char)c;
+  CHECK_STRING(kept, got);
+  CHECK_EQUAL(-1, ble.peek());
+
+  module.remoteSend("xyz");
+  pollFor(ble, 50);
+  char buffer[8];
+  CHECK_EQUAL(3, ble.read(buffer, sizeof(buffer)));
+  CHECK(memcmp(buffer, "xyz", 3) == 0);
+  CHECK_EQUAL(20, ble.rxOverflowCount());
+}
+
+TEST(amCentral)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  boolean central = true;
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.amCentral(central));
+  CHECK(!central);
+  ble.BLECentral();
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.amCentral(central));
+  CHECK(central);
+}
+
+// VER never ends in OK, but we don't wait around for one; and once we know
+//  the address, we don't ask again.
+TEST(addressQuery)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  String address;
+  unsigned long start = millis();
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.addressQuery(address));
+  CHECK(millis() - start < 200);
+  CHECK_STRING(module.address(), address);
+  size_t from = module.commands.size();
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.addressQuery(address));
+  String version;
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.firmwareVersion(version));
+  CHECK_STRING("2.6.0", version);
+  CHECK_EQUAL(from, module.commands.size());
+}
+
+// Once adaptDeadlines() has seen a few SETs, they get a deadline a lot
+//  shorter than the usual two seconds.
+TEST(adaptiveDeadline)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  ble.adaptDeadlines(true);
+  CHECK_EQUAL(0, ble.learnedDeadline(BLEMate2::CMD_STD));
+  for (byte i = 0; i < 10; i++)
+  {
+    CHECK_EQUAL(BLEMate2::SUCCESS, ble.stdSetParam("ADVP", "FAST"));
+  }
+  unsigned int learned = ble.learnedDeadline(BLEMate2::CMD_STD);
+  CHECK(learned >= BLE_MATE2_DEADLINE_FLOOR);
+  CHECK(learned < 200);
+}
+
+// WRT and RTR take the module longer than any SET. What the SETs taught it
+//  mustn't time them out, and they mustn't throw off what it learned.
+TEST(adaptiveDeadlineSlowCommands)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  ble.adaptDeadlines(true);
+  for (byte i = 0; i < 10; i++) ble.stdSetParam("ADVP", "FAST");
+  unsigned int learned = ble.learnedDeadline(BLEMate2::CMD_STD);
+  unsigned int resyncs = ble.resyncCount();
+  module.setLatency("WRT", 150);
+  module.setLatency("RTR", 150);
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.writeConfig());
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.restore());
+  CHECK_EQUAL(resyncs, ble.resyncCount());
+  CHECK_EQUAL(learned, ble.learnedDeadline(BLEMate2::CMD_STD));
+}
@@ -0,0 +1,96 @@
+/****************************************************************
+Framing binary data over the link.
+
+This code is beerware; if you use it, please buy me (or any other
+SparkFun employee) a cold beverage next time you run into one of
+us at the local.
+****************************************************************/
+
+#include "Helpers.h"
+#include <SparkFunFraming.h>
+
+static std::string lastFrame;
+static unsigned int frames;
+
+static void gotFrame(const byte *data, byte len)
+{
+  lastFrame.assign((const char *)data, len);
+  frames++;
+}
+
+// Everything, carriage returns and line feeds included, makes it through,
+//  however the module splits it up on the way.
+TEST(framingRoundTrip)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  module.remoteConnect("20FABB0000FF");
+  BLEMate2Framer framer(&ble);
+  byte data[200];
+  for (unsigned int i = 0; i < sizeof(data); i++) data[i] = i * 7;
+  data[3] = '\r';
+  data[4] = '\n';
+  CHECK_EQUAL(BLEMate2::SUCCESS, framer.sendFrame(data, 60));
+  std::string wire = module.sent;
+  CHECK(wire.find('\r') == std::string::npos);
+  CHECK(wire.find('\n') == std::string::npos);
+
+  // Back in, in pieces.
+  BLEMate2Framer receiver(&ble);
+  frames = 0;
+  receiver.onFrame(gotFrame);
+  for (size_t i = 0; i < wire.size(); i += 7)
+  {
+    module.remoteSend(wire.substr(i, 7).c_str());
+  }
+  unsigned long start = millis();
+  while (millis() - start < 500) receiver.poll();
+  CHECK_EQUAL(1, frames);
+  CHECK_EQUAL(1, receiver.frameCount());
+  CHECK(lastFrame == std::string((const char *)data, 60));
+}
+
+// A message that's been damaged on the way is thrown away.
+TEST(framingBadFrame)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  module.remoteConnect("20FABB0000FF");
+  BLEMate2Framer framer(&ble);
+  byte data[] = {1, 2, 3, 4, 5};
+  CHECK_EQUAL(BLEMate2::SUCCESS, framer.sendFrame(data, sizeof(data)));
+  std::string wire = module.sent;
+
+  BLEMate2Framer receiver(&ble);
+  frames = 0;
+  receiver.onFrame(gotFrame);
+  std::string damaged = wire;
+  damaged[damaged.size() / 2] ^= 0x01;
+  receiver.feed(damaged.data(), damaged.size());
+  CHECK_EQUAL(0, frames);
+  CHECK_EQUAL(1, receiver.badFrameCount());
+  receiver.feed(wire.data(), wire.size());
+  CHECK_EQUAL(1, frames);
+}
+
+// sendFrame() reports on its own send, not on everything else in the queue.
+TEST(framingSendResult)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  module.remoteConnect("20FABB0000FF");
+  BLEMate2Framer framer(&ble);
+  byte data[] = {1, 2, 3, 4, 5};
+  module.failNext("SET ACON");
+  ble.beginSetParam("ACON", "OFF");
+  CHECK_EQUAL(BLEMate2::SUCCESS, framer.sendFrame(data, sizeof(data)));
+
+  module.failNext("SND", BLE_MATE2_SEND_RETRIES + 1);
+  CHECK_EQUAL(BLEMate2::MODULE_ERROR, framer.sendFrame(data, sizeof(data)));
+  module.sent.clear();
+  CHECK_EQUAL(BLEMate2::SUCCESS, framer.sendFrame(data, sizeof(data)));
+  CHECK(module.sent.size() > sizeof(data));
+}
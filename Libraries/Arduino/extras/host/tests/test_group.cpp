@@ -0,0 +1,117 @@
+/****************************************************************
+Several modules at once.
+
+This code is beerware; if you use it, please buy me (or any other
+SparkFun employee) a cold beverage next time you run into one of
+us at the local.
+****************************************************************/
+
+#include "Helpers.h"
+#include <SparkFunGroup.h>
+
+// The group only answers for the modules it gave something to; a failure
+//  on a module that sat out doesn't count against it.
+TEST(groupResultsFromMembers)
+{
+  BC118Emulator module0, module1, module2;
+  BLEMate2 ble0(&module0), ble1(&module1), ble2(&module2);
+  BLEMate2Group group;
+  group.add(&ble0);
+  group.add(&ble1);
+  group.add(&ble2);
+  ble0.reset();
+  ble1.reset();
+  ble2.reset();
+  module0.remoteConnect("20FABB0000F0");
+  module1.remoteConnect("20FABB0000F1");
+  group.waitForIdle();
+  pollFor(ble0, 50);
+  pollFor(ble1, 50);
+  module2.failNext("SET");
+  CHECK_EQUAL(BLEMate2::MODULE_ERROR, ble2.stdSetParam("ACON", "OFF"));
+  CHECK_EQUAL(BLEMate2::SUCCESS, group.sendAll("hello", 5));
+  CHECK_STRING("hello", module0.sent);
+  CHECK_STRING("hello", module1.sent);
+  CHECK_STRING("", module2.sent);
+
+  // The same goes for a connect handed out by the group: only the module
+  //  that got it is asked how it went.
+  becomeCentral(ble1);
+  module1.addDevice("20FABB000010", "one", -40);
+  module2.remoteConnect("20FABB0000F2");
+  pollFor(ble2, 50);
+  module2.failNext("SET");
+  ble2.beginSetParam("ACON", "OFF");
+  byte which = 0xFF;
+  CHECK_EQUAL(BLEMate2::SUCCESS, group.beginConnect(String("20FABB000010"),
+                                                    which));
+  CHECK_EQUAL(1, which);
+  CHECK_EQUAL(BLEMate2::SUCCESS, group.waitForIdle());
+  CHECK_EQUAL(BLEMate2::MODULE_ERROR, ble2.waitForIdle());
+  CHECK(module1.connected());
+}
+
+// A module with a full queue doesn't stop the others from sending, and the
+//  group's send rate only counts what went out.
+TEST(groupSendWithBusyModule)
+{
+  BC118Emulator module0, module1;
+  BLEMate2 ble0(&module0), ble1(&module1);
+  BLEMate2Group group;
+  group.add(&ble0);
+  group.add(&ble1);
+  ble0.reset();
+  ble1.reset();
+  module0.remoteConnect("20FABB0000F0");
+  module1.remoteConnect("20FABB0000F1");
+  pollFor(ble0, 50);
+  pollFor(ble1, 50);
+  for (byte i = 0; i < BLE_MATE2_QUEUE_SIZE; i++)
+  {
+    ble1.beginStdCmd("ADV OFF");
+  }
+  CHECK_EQUAL(BLEMate2::BUSY_ERROR, group.sendAll("hello", 5));
+  CHECK_STRING("hello", module0.sent);
+  CHECK_STRING("", module1.sent);
+  CHECK(!group.busy());
+  CHECK(group.sendRate() > 0);
+  CHECK(group.sendRate() <= ble0.sendRate() + 1);
+}
+
+// From inside a module's callback, that module can't move, so the group's
+//  blocking functions say so rather than hang.
+static BLEMate2Group *callbackGroup;
+static BLEMate2::opResult groupResults[2];
+
+static void groupFromCallback()
+{
+  groupResults[0] = callbackGroup->waitForIdle();
+  groupResults[1] = callbackGroup->sendAll("hello", 5);
+}
+
+TEST(groupBlockingFromCallback)
+{
+  BC118Emulator module0, module1;
+  BLEMate2 ble0(&module0), ble1(&module1);
+  BLEMate2Group group;
+  group.add(&ble0);
+  group.add(&ble1);
+  ble0.reset();
+  ble1.reset();
+  module1.remoteConnect("20FABB0000F1");
+  pollFor(ble1, 50);
+
+  callbackGroup = &group;
+  ble0.onConnect(groupFromCallback);
+  module0.setLatency(50);
+  ble0.beginStdCmd("ADV ON");
+  module0.remoteConnect("20FABB0000F0");
+  unsigned long start = millis();
+  pollFor(ble0, 20);
+  CHECK(millis() - start < 1000);
+  CHECK_EQUAL(BLEMate2::BUSY_ERROR, groupResults[0]);
+  CHECK_EQUAL(BLEMate2::BUSY_ERROR, groupResults[1]);
+  CHECK_STRING("", module1.sent);
+  ble0.onConnect(NULL);
+  CHECK_EQUAL(BLEMate2::SUCCESS, group.waitForIdle());
+}
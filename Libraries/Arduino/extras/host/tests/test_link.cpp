@@ -0,0 +1,257 @@
+/****************************************************************
+Connections: making them, losing them and getting them back.
+
+This code is beerware; if you use it, please buy me (or any other
+SparkFun employee) a cold beverage next time you run into one of
+us at the local.
+****************************************************************/
+
+#include "Helpers.h"
+
+TEST(connectByAddress)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  becomeCentral(ble);
+  module.addDevice("20FABB000010", "one", -40);
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.connect(String("20FABB000010")));
+  CHECK(module.connected());
+  CHECK_STRING("20FABB000010", module.peer());
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.connectionState());
+  CHECK(ble.connectLatency() >= 150);
+
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.disconnect());
+  CHECK(!module.connected());
+  CHECK_EQUAL(BLEMate2::CONNECT_ERROR, ble.connectionState());
+}
+
+TEST(connectBadAddress)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  becomeCentral(ble);
+  size_t from = module.commands.size();
+  CHECK_EQUAL(BLEMate2::INVALID_PARAM, ble.connect(String("20FABB")));
+  CHECK_EQUAL(from, module.commands.size());
+}
+
+// A filter connects to the first device that fits, the moment it's heard.
+TEST(connectByFilter)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  becomeCentral(ble);
+  module.addDevice("20FABB000010", "lamp", -40);
+  module.addDevice("20FABB000020", "sensor", -80);
+  module.addDevice("20FABB000030", "sensor", -50);
+  BLEMate2::connectFilter filter;
+  memset(&filter, 0, sizeof(filter));
+  filter.minRssi = -60;
+  filter.namePrefix = "sens";
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.connect(filter, 2000));
+  CHECK_STRING("20FABB000030", module.peer());
+}
+
+TEST(connectFilterTimesOut)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  becomeCentral(ble);
+  module.addDevice("20FABB000010", "lamp", -40);
+  BLEMate2::connectFilter filter;
+  memset(&filter, 0, sizeof(filter));
+  filter.minRssi = -128;
+  filter.namePrefix = "sens";
+  CHECK_EQUAL(BLEMate2::REMOTE_ERROR, ble.connect(filter, 1000));
+  CHECK(!module.connected());
+}
+
+// A peripheral finds out about connections from the module.
+TEST(remoteConnects)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  module.remoteConnect("20FABB0000FF");
+  pollFor(ble, 50);
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.connectionState());
+  module.remoteDisconnect();
+  pollFor(ble, 50);
+  CHECK_EQUAL(BLEMate2::CONNECT_ERROR, ble.connectionState());
+}
+
+// When the link drops, the supervisor gets it back.
+TEST(autoReconnect)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  becomeCentral(ble);
+  module.addDevice("20FABB000010", "one", -40);
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.connect(String("20FABB000010")));
+  ble.autoReconnect();
+  module.remoteDisconnect();
+  pollFor(ble, 3000);
+  CHECK(module.connected());
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.connectionState());
+  CHECK_EQUAL(1, ble.reconnectCount());
+  CHECK(ble.linkDowntime() > 0);
+}
+
+// A reconnect that comes due while a blocking call is queueing its command
+//  goes in the queue ahead of it; it mustn't take the same slot.
+TEST(reconnectWhileQueueing)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  ble.autoReconnect("20FABB000001");
+  size_t from = module.commands.size();
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.stdSetParam("NAME", "hello"));
+  CHECK_STRING("hello", module.param("NAME"));
+  CHECK_EQUAL(1, countCommands(module, "SET NAME=hello", from));
+  CHECK_EQUAL(1, countCommands(module, "SCN ON", from));
+}
+
+// A link to a peer whose CONs all fail, so the supervisor keeps trying. The
+//  gaps are the times between one attempt's SCN ON and the next one's.
+static void reconnectGaps(byte jitter, unsigned long *gaps, byte n)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  becomeCentral(ble);
+  module.addDevice("20FABB000010", "one", -40);
+  ble.connect(String("20FABB000010"));
+  ble.setReconnectBackoff(1000, 1000);
+  ble.setReconnectJitter(jitter);
+  ble.autoReconnect();
+  module.failNext("CON", 20);
+  module.remoteDisconnect();
+
+  size_t from = module.commands.size();
+  unsigned int attempts = 0;
+  unsigned long last = 0;
+  unsigned long start = millis();
+  while (attempts <= n && millis() - start < 20000)
+  {
+    ble.poll();
+    if (countCommands(module, "SCN ON", from) == attempts) continue;
+    if (attempts > 0) gaps[attempts - 1] = millis() - last;
+    last = millis();
+    attempts++;
+  }
+  CHECK_EQUAL(n + 1, attempts);
+}
+
+// Without jitter, the retries come like clockwork; with it, they don't. An
+//  attempt can go out a little late either way, if the scan reports coming
+//  in have it resync first, so the shortest gap without jitter is the one
+//  to measure from.
+TEST(reconnectJitter)
+{
+  unsigned long gaps[4];
+  reconnectGaps(0, gaps, 4);
+  unsigned long base = gaps[0];
+  for (byte i = 1; i < 4; i++)
+  {
+    if (gaps[i] < base) base = gaps[i];
+  }
+  for (byte i = 0; i < 4; i++)
+  {
+    CHECK(gaps[i] <= base + 50);
+  }
+
+  // Up to 100% more.
+  unsigned long spread[4];
+  reconnectGaps(100, spread, 4);
+  unsigned long lowest = spread[0];
+  unsigned long highest = spread[0];
+  for (byte i = 0; i < 4; i++)
+  {
+    CHECK(spread[i] + 5 >= base && spread[i] <= base + 1000 + 50);
+    if (spread[i] < lowest) lowest = spread[i];
+    if (spread[i] > highest) highest = spread[i];
+  }
+  CHECK(highest - lowest > 100);
+}
+
+// A disconnect that can't be queued doesn't happen, so it mustn't stop the
+//  supervisor either.
+TEST(disconnectBusyKeepsReconnect)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  becomeCentral(ble);
+  module.addDevice("20FABB000010", "one", -40);
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.connect(String("20FABB000010")));
+  ble.autoReconnect();
+  module.setLatency("ADV", 200);
+  while (ble.beginStdCmd("ADV OFF") == BLEMate2::SUCCESS);
+  CHECK_EQUAL(BLEMate2::BUSY_ERROR, ble.beginDisconnect());
+
+  module.remoteDisconnect();
+  pollFor(ble, 5000);
+  CHECK(module.connected());
+  CHECK_EQUAL(1, ble.reconnectCount());
+}
+
+// The blocking functions can't finish from inside poll(), so from a
+//  callback they say so rather than hang.
+static BLEMate2 *callbackModule;
+static BLEMate2::opResult callbackResults[3];
+
+static void blockFromCallback()
+{
+  callbackResults[0] = callbackModule->stdCmd("ADV OFF");
+  callbackResults[1] = callbackModule->waitForIdle();
+  String address;
+  callbackResults[2] = callbackModule->addressQuery(address);
+}
+
+TEST(blockingFromCallback)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  callbackModule = &ble;
+  ble.onConnect(blockFromCallback);
+  module.setLatency(50);
+  ble.beginStdCmd("ADV ON");
+  module.remoteConnect("20FABB0000FF");
+  size_t from = module.commands.size();
+  unsigned long start = millis();
+  pollFor(ble, 20);
+  CHECK(millis() - start < 100);
+  CHECK_EQUAL(BLEMate2::BUSY_ERROR, callbackResults[0]);
+  CHECK_EQUAL(BLEMate2::BUSY_ERROR, callbackResults[1]);
+  CHECK_EQUAL(BLEMate2::BUSY_ERROR, callbackResults[2]);
+  CHECK_EQUAL(from, module.commands.size());
+  ble.onConnect(NULL);
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.waitForIdle());
+}
+
+// Same goes for onComplete() on a timeout, which is called from further
+//  along in poll() than the events are. If the reset went through, the
+//  stdCmd() it was called from would take the reset's result for its own.
+static void resetOnTimeout(BLEMate2::opResult result)
+{
+  if (result == BLEMate2::TIMEOUT_ERROR)
+  {
+    callbackResults[0] = callbackModule->reset();
+  }
+}
+
+TEST(blockingFromTimeoutCallback)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  callbackModule = &ble;
+  callbackResults[0] = BLEMate2::SUCCESS;
+  ble.onComplete(resetOnTimeout);
+  module.setDeaf(true);
+  size_t from = module.commands.size();
+  CHECK_EQUAL(BLEMate2::TIMEOUT_ERROR, ble.stdCmd("ADV OFF"));
+  CHECK_EQUAL(BLEMate2::BUSY_ERROR, callbackResults[0]);
+  CHECK_EQUAL(0, countCommands(module, "RST", from));
+  ble.onComplete(NULL);
+}
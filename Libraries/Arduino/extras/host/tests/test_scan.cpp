@@ -0,0 +1,164 @@
+/****************************************************************
+Scanning, and the scan table.
+
+This code is beerware; if you use it, please buy me (or any other
+SparkFun employee) a cold beverage next time you run into one of
+us at the local.
+****************************************************************/
+
+#include "Helpers.h"
+
+static unsigned int appeared;
+static unsigned int disappeared;
+
+static void countAppear(const BLEMate2::scanEntry &)
+{
+  appeared++;
+}
+
+static void countDisappear(const BLEMate2::scanEntry &)
+{
+  disappeared++;
+}
+
+// A timed scan fills the table with everything it heard, each device once
+//  no matter how often it was heard.
+TEST(scanFindsDevices)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  becomeCentral(ble);
+  module.addDevice("20FABB000010", "one", -40);
+  module.addDevice("20FABB000020", "two", -70);
+  module.addDevice("20FABB000030", "three", -55);
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.BLEScan(1));
+  CHECK_EQUAL(3, ble.numAddresses());
+
+  BLEMate2::scanEntry list[3];
+  CHECK_EQUAL(3, ble.strongest(list, 3));
+  char text[13];
+  BLEMate2::formatAddress(list[0].address, text);
+  CHECK_STRING("20FABB000010", std::string(text));
+  BLEMate2::formatAddress(list[2].address, text);
+  CHECK_STRING("20FABB000020", std::string(text));
+  CHECK_EQUAL(-55, list[1].rssi);
+  CHECK(list[0].hits > 1);
+}
+
+// Finding nothing is a REMOTE_ERROR.
+TEST(scanFindsNothing)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  becomeCentral(ble);
+  CHECK_EQUAL(BLEMate2::REMOTE_ERROR, ble.BLEScan(1));
+  CHECK_EQUAL(0, ble.numAddresses());
+}
+
+// A full table makes room for a stronger device by dropping the weakest,
+//  and says so.
+TEST(scanTableFull)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  becomeCentral(ble);
+  char address[13];
+  for (byte i = 0; i < BLE_MATE2_SCAN_SIZE; i++)
+  {
+    snprintf(address, sizeof(address), "20FABB0001%02X", i);
+    module.addDevice(address, "dev", -60 - i, 1000);
+  }
+  appeared = disappeared = 0;
+  ble.onDeviceAppear(countAppear);
+  ble.onDeviceDisappear(countDisappear);
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.startScanning());
+  pollFor(ble, 500);
+  CHECK_EQUAL(BLE_MATE2_SCAN_SIZE, ble.numAddresses());
+  CHECK_EQUAL(BLE_MATE2_SCAN_SIZE, appeared);
+
+  module.addDevice("20FABB000200", "strong", -30, 1000);
+  module.addDevice("20FABB000201", "weak", -99, 1000);
+  pollFor(ble, 500);
+  CHECK_EQUAL(BLE_MATE2_SCAN_SIZE, ble.numAddresses());
+  CHECK_EQUAL(BLE_MATE2_SCAN_SIZE + 1, appeared);
+  CHECK_EQUAL(1, disappeared);
+  BLEMate2::scanEntry best;
+  ble.strongest(&best, 1);
+  CHECK_EQUAL(-30, best.rssi);
+  ble.onDeviceAppear(NULL);
+  ble.onDeviceDisappear(NULL);
+}
+
+// With aging on, a device that goes quiet drops out of the table.
+TEST(scanAging)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  becomeCentral(ble);
+  module.addDevice("20FABB000010", "one", -40);
+  module.addDevice("20FABB000020", "two", -70);
+  ble.setScanAging(500);
+  disappeared = 0;
+  ble.onDeviceDisappear(countDisappear);
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.startScanning());
+  pollFor(ble, 300);
+  CHECK_EQUAL(2, ble.numAddresses());
+  module.removeDevice("20FABB000010");
+  pollFor(ble, 1000);
+  CHECK_EQUAL(1, ble.numAddresses());
+  CHECK_EQUAL(1, disappeared);
+  String address;
+  ble.getAddress(0, address);
+  CHECK_STRING("20FABB000020", address);
+  ble.onDeviceDisappear(NULL);
+}
+
+// A timed scan starts from an empty table, but not until the scan itself
+//  starts, and everything it clears out is reported as gone.
+TEST(scanClearsTable)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  becomeCentral(ble);
+  module.addDevice("20FABB000010", "one", -40);
+  module.addDevice("20FABB000020", "two", -70);
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.BLEScan(1));
+  CHECK_EQUAL(2, ble.numAddresses());
+
+  module.removeDevice("20FABB000010");
+  disappeared = 0;
+  ble.onDeviceDisappear(countDisappear);
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.beginScan(1));
+  CHECK_EQUAL(2, ble.numAddresses());
+  CHECK_EQUAL(0, disappeared);
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.waitForIdle());
+  CHECK_EQUAL(2, disappeared);
+  CHECK_EQUAL(1, ble.numAddresses());
+  ble.onDeviceDisappear(NULL);
+}
+
+// BLEScan(0) is a continuous scan, like startScanning(): it's done once the
+//  scan is on, and what's already in the table stays.
+TEST(scanZeroContinues)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  becomeCentral(ble);
+  module.addDevice("20FABB000010", "one", -40);
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.BLEScan(1));
+  CHECK_EQUAL(1, ble.numAddresses());
+
+  module.removeDevice("20FABB000010");
+  module.addDevice("20FABB000020", "two", -70);
+  disappeared = 0;
+  ble.onDeviceDisappear(countDisappear);
+  unsigned long start = millis();
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.BLEScan(0));
+  CHECK(millis() - start < 1000);
+  CHECK(module.scanning());
+  CHECK_EQUAL(0, disappeared);
+  pollFor(ble, 500);
+  CHECK_EQUAL(2, ble.numAddresses());
+  CHECK(module.scanning());
+  ble.onDeviceDisappear(NULL);
+}
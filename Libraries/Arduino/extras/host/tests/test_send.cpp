@@ -0,0 +1,98 @@
+/****************************************************************
+Sending data to the remote device.
+
+This code is beerware; if you use it, please buy me (or any other
+SparkFun employee) a cold beverage next time you run into one of
+us at the local.
+****************************************************************/
+
+#include "Helpers.h"
+
+static std::string pattern(size_t len)
+{
+  std::string data;
+  for (size_t i = 0; i < len; i++) data += (char)('a' + i % 26);
+  return data;
+}
+
+// As a peripheral, data goes out 125 bytes at a time.
+TEST(sendPeripheral)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  module.remoteConnect("20FABB0000FF");
+  std::string data = pattern(300);
+  size_t from = module.commands.size();
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.sendData(data.c_str(), data.size()));
+  CHECK_STRING(data, module.sent);
+  CHECK_EQUAL(3, countCommands(module, "SND", from));
+}
+
+// As a central, it's 20.
+TEST(sendCentral)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  becomeCentral(ble);
+  module.addDevice("20FABB000010", "one", -40);
+  ble.connect(String("20FABB000010"));
+  std::string data = pattern(50);
+  size_t from = module.commands.size();
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.sendData(data.c_str()));
+  CHECK_STRING(data, module.sent);
+  CHECK_EQUAL(3, countCommands(module, "SND", from));
+}
+
+// An ERR on a chunk gets it sent again, a couple of times.
+TEST(sendRetries)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  module.remoteConnect("20FABB0000FF");
+  std::string data = pattern(200);
+  module.failNext("SND", 1);
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.sendData(data.c_str(), data.size()));
+  CHECK_STRING(data, module.sent);
+  CHECK_EQUAL(1, ble.retransmitCount());
+
+  module.sent.clear();
+  module.failNext("SND", BLE_MATE2_SEND_RETRIES + 1);
+  CHECK_EQUAL(BLEMate2::MODULE_ERROR, ble.sendData(data.c_str(), data.size()));
+  CHECK_STRING("", module.sent);
+}
+
+// Data can come from a Stream, or from a function, as well as a buffer.
+static std::string sourceData;
+static size_t sourcePos;
+
+static size_t fromString(char *buffer, size_t maxLen)
+{
+  size_t n = sourceData.size() - sourcePos;
+  if (n > maxLen) n = maxLen;
+  memcpy(buffer, sourceData.data() + sourcePos, n);
+  sourcePos += n;
+  return n;
+}
+
+TEST(sendFromFunction)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  module.remoteConnect("20FABB0000FF");
+  sourceData = pattern(260);
+  sourcePos = 0;
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.sendData(fromString));
+  CHECK_STRING(sourceData, module.sent);
+}
+
+TEST(sendNotConnected)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  CHECK(ble.sendData("hello") != BLEMate2::SUCCESS);
+  CHECK_STRING("", module.sent);
+}
@@ -0,0 +1,105 @@
+/****************************************************************
+Command statistics. Only built when they're compiled in ("make
+options").
+
+This code is beerware; if you use it, please buy me (or any other
+SparkFun employee) a cold beverage next time you run into one of
+us at the local.
+****************************************************************/
+
+#include "Helpers.h"
+
+#if BLE_MATE2_STATS
+
+// Counts, errors and times for each kind of command, and the bytes each way.
+//  Every command here takes the module 10 ms to think about, on top of the
+//  time on the wire, one at a time.
+TEST(statsCounts)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  ble.resetStats();
+  module.setLatency(10);
+  String name;
+  ble.stdCmd("ADV OFF");
+  ble.stdCmd("ADV OFF");
+  ble.stdGetParam("NAME", name);
+  module.failNext("SET ACON");
+  ble.stdSetParam("ACON", "OFF");
+
+  BLEMate2::stats s;
+  ble.getStats(s);
+  const BLEMate2::cmdStats &std = s.cmd[BLEMate2::CMD_STD];
+  CHECK_EQUAL(3, std.count);
+  CHECK_EQUAL(3, std.timed);
+  CHECK_EQUAL(1, std.errors);
+  CHECK_EQUAL(0, std.timeouts);
+  CHECK(std.minTime >= 10);
+  CHECK(std.maxTime < 40);
+  CHECK(std.minTime <= std.totalTime / std.timed);
+  CHECK(std.totalTime / std.timed <= std.maxTime);
+  const BLEMate2::cmdStats &get = s.cmd[BLEMate2::CMD_GET];
+  CHECK_EQUAL(1, get.count);
+  CHECK(get.minTime >= 10);
+  CHECK_EQUAL(get.minTime, get.maxTime);
+  CHECK_EQUAL(0, s.cmd[BLEMate2::CMD_RESET].count);
+
+  // "ADV OFF\r" twice, "GET NAME\r" and "SET ACON=OFF\r" out; "OK\n\r" for
+  //  each ADV, "NAME=BC118\n\rOK\n\r" and "ERR\n\r" back.
+  CHECK_EQUAL(8 + 8 + 9 + 13, s.bytesOut);
+  CHECK_EQUAL(4 + 4 + 16 + 5, s.bytesIn);
+  CHECK_EQUAL(0, s.unsolicited);
+  CHECK_EQUAL(0, s.resyncs);
+
+  captured out;
+  ble.dumpStats(out);
+  CHECK_STRING("STD 3/1/0 ", out.text.substr(0, 10));
+  CHECK(out.text.find(" GET 1/0/0 ") != std::string::npos);
+  CHECK(out.text.find(" tx 38 rx 29 uns 0 rs 0\r\n") != std::string::npos);
+}
+
+// A timeout counts against its command, and its time is the deadline.
+TEST(statsTimeout)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  ble.resetStats();
+  ble.setDeadline(BLEMate2::CMD_STD, 100);
+  module.setDeaf(true);
+  ble.stdCmd("ADV OFF");
+  BLEMate2::stats s;
+  ble.getStats(s);
+  CHECK_EQUAL(1, s.cmd[BLEMate2::CMD_STD].timeouts);
+  CHECK(s.cmd[BLEMate2::CMD_STD].maxTime >= 100);
+  module.setDeaf(false);
+  ble.stdCmd("ADV OFF");
+  ble.getStats(s);
+  CHECK_EQUAL(1, s.resyncs);
+}
+
+// Lines nobody wanted count as unsolicited, whether they turn up while the
+//  library's waiting on an answer or not. The banner from a reset and the
+//  value from a GET don't.
+TEST(statsUnsolicited)
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  ble.resetStats();
+  module.sayLine("hello");
+  pollFor(ble, 50);
+  module.setLatency(50);
+  ble.beginStdCmd("ADV OFF");
+  module.sayLine("there", 20);
+  ble.waitForIdle();
+  String name;
+  ble.stdGetParam("NAME", name);
+  ble.reset();
+  BLEMate2::stats s;
+  ble.getStats(s);
+  CHECK_EQUAL(2, s.unsolicited);
+}
+
+#endif
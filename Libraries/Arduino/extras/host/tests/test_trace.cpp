@@ -0,0 +1,77 @@
+/****************************************************************
+The wire-level trace, and playing it back. Only built when the
+trace is compiled in ("make options").
+
+This code is beerware; if you use it, please buy me (or any other
+SparkFun employee) a cold beverage next time you run into one of
+us at the local.
+****************************************************************/
+
+#include "Helpers.h"
+#include "TraceReplay.h"
+
+#if BLE_MATE2_TRACE_SIZE > 0
+
+// A reset and a couple of commands, from a library that's never talked to
+//  the module before; that's a trace a fresh library can follow.
+static std::string takeTrace()
+{
+  BC118Emulator module;
+  BLEMate2 ble(&module);
+  ble.reset();
+  String name;
+  ble.stdGetParam("NAME", name);
+  ble.stdSetParam("ACON", "OFF");
+  captured out;
+  ble.dumpTrace(out);
+  return out.text;
+}
+
+// Time, direction and bytes in hex, a line per burst, starting with the
+//  bare "\r" of the first resync and the ERR it gets back.
+TEST(traceDump)
+{
+  std::string text = takeTrace();
+  CHECK_STRING("0 T 0D\r\n", text.substr(0, 8));
+  size_t err = text.find(" R 45 52 52 0A 0D\r\n");
+  CHECK(err != std::string::npos);
+  CHECK(text.find(" T 52 53 54 0D\r\n") > err);
+  CHECK(text.find(" T 47 45 54 20 4E 41 4D 45 0D\r\n") != std::string::npos);
+}
+
+// Played back, the trace takes the library through the same calls with the
+//  same results, without the emulator.
+TEST(traceReplay)
+{
+  std::string text = takeTrace();
+  TraceReplay replay;
+  CHECK(replay.load(text.c_str()) > 0);
+  BLEMate2 ble(&replay);
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.reset());
+  String name;
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.stdGetParam("NAME", name));
+  CHECK_STRING("BC118", name);
+  CHECK_EQUAL(BLEMate2::SUCCESS, ble.stdSetParam("ACON", "OFF"));
+  CHECK(replay.done());
+  CHECK_EQUAL(0, replay.mismatches());
+  CHECK_EQUAL(1, ble.resyncCount());
+}
+
+// A library that goes a different way from the trace is caught at the
+//  first byte that's different.
+TEST(traceReplayMismatch)
+{
+  std::string text = takeTrace();
+  TraceReplay replay;
+  replay.load(text.c_str());
+  BLEMate2 ble(&replay);
+  ble.setDeadline(BLEMate2::CMD_GET, 100);
+  ble.reset();
+  String value;
+  CHECK(ble.stdGetParam("ACON", value) != BLEMate2::SUCCESS);
+  CHECK(!replay.done());
+  CHECK(replay.mismatches() > 0);
+  CHECK_EQUAL(strlen("\rRST\rSCN OFF\rGET "), replay.firstMismatch());
+}
+
+#endif
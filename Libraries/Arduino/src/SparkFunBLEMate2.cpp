@@ -20,251 +20,456 @@ Code developed in Arduino 1.0.6, on an Arduino Pro 5V.
 BLEMate2::BLEMate2(Stream *sp)
 {
   _serialPort = sp;
-  _numAddresses = 0;
+  _scanCount = 0;
+  _scanPolicy = EVICT_WEAKEST;
+  _scanMaxAge = 0;
+  _ageCursor = 0;
+  _appearCallback = NULL;
+  _disappearCallback = NULL;
+  _connectStart = 0;
+  _connectLatency = 0;
+  _linkUp = false;
+  _linkSince = 0;
+  _upTotal = 0;
+  _downTotal = 0;
+  _havePeer = false;
+  _reconnect = false;
+  _reconnectAt = 0;
+  _reconnectMin = 500;
+  _reconnectMax = 30000;
+  _reconnectJitter = 25;
+  _reconnectDelay = _reconnectMin;
+  _reconnectSeq = 0;
+  _reconnects = 0;
+  _lastRxTime = 0;
+  _role = ROLE_UNKNOWN;
+  _synced = false;  // We have no idea what state the module is in yet.
+  _resyncCount = 0;
+  _firmware[0] = '\0';
+  _haveIdentity = false;
+  for (byte i = 0; i < CMD_TYPES; i++) _deadlines[i] = 0;
+  _adapt = false;
+  for (byte i = 0; i < ADAPT_TYPES; i++) _latencySamples[i] = 0;
+  _qHead = 0;
+  _qCount = 0;
+  _qSent = 0;
+  _pipelineDepth = BLE_MATE2_QUEUE_SIZE;
+  _batch = 0;
+  _inBatch = false;
+  _failedBatch = 0xFF;
+  _seq = 0;
+  _waitSeq = 0;
+  _syncing = false;
+  _owed = 0;
+  _lastResult = DEFAULT_ERR;
+  _idleResult = SUCCESS;
+  _callback = NULL;
+  _connectCallback = NULL;
+  _disconnectCallback = NULL;
+  _scanCallback = NULL;
+  _dataCallback = NULL;
+  _sendRate = 0;
+  _retransmits = 0;
+  _rxHead = 0;
+  _rxCount = 0;
+  _rxOverflows = 0;
+  _polling = false;
+  _baudRate = 9600; // The factory default.
+  _baudThroughput = 0;
+#if BLE_MATE2_STATS
+  resetStats();
+#endif
+#if BLE_MATE2_TRACE_SIZE > 0
+  clearTrace();
+#endif
+  clearLine();
 }
 
 // The only way to get the true full address of the module is to check the
 //  module's firmware version with the "VER" command. The stdCmd() function
 //  isn't really useful here; we'll take our cue from the BLEScan() function.
+//  The address and the firmware version both come out of VER, and neither is
+//  going to change, so we keep them the first time through; after that, the
+//  blocking versions answer without bothering the module at all.
+//  beginAddressQuery() always asks (and refreshes what we've kept).
 BLEMate2::opResult BLEMate2::addressQuery(String &address)
 {
+  if (!_haveIdentity)
+  {
+    if (waitForRoom() != SUCCESS) return BUSY_ERROR;
+    return blockUntilDone(beginAddressQuery(address));
+  }
+  char text[13];
+  formatAddress(_moduleAddress, text);
+  address = text;
+  return SUCCESS;
+}
+
+// Just the version number, as in "2.6.0".
+BLEMate2::opResult BLEMate2::firmwareVersion(String &version)
+{
+  if (!_haveIdentity)
+  {
+    if (waitForRoom() != SUCCESS) return BUSY_ERROR;
+    opResult result = blockUntilDone(beginIdentity(NULL));
+    if (result != SUCCESS) return result;
+  }
+  version = _firmware;
+  return SUCCESS;
+}
+
+BLEMate2::opResult BLEMate2::beginAddressQuery(String &address)
+{
+  return beginIdentity(&address);
+}
+
+BLEMate2::opResult BLEMate2::beginIdentity(String *address)
+{
+  cmdEntry *cmd = newCommand(CMD_VERSION, 2000);
+  if (cmd == NULL) return BUSY_ERROR;
   // We're going to assume a failure to find the appropriate string, but a
   //  response of some kind. We'll call that a MODULE_ERROR.
-  opResult result  = MODULE_ERROR;
-  String buffer = "";
-  String EOL = String("\n\r");
-  
-  knownStart();
-  
-  // Send the command and wait for it to complete.
-  _serialPort->print("VER\r");
-  _serialPort->flush();
-  
-  // We're going to use the internal timer to track the elapsed time since we
-  //  issued the command. Bog-standard Arduino stuff.
-  unsigned long loopStart = millis();
-  unsigned long loopTimeout = 2000;
-  
-  // Oooookaaaayyy...now the fun part. A state machine that parses the input
-  //  from the Bluetooth module!
-  while (loopStart + loopTimeout > millis())
+  cmd->result = MODULE_ERROR;
+  cmd->out.string = address;
+  buildCmd(cmd, ID_VER);
+  return queueCommand(cmd);
+}
+
+// The BC118 doesn't want a nice, human readable string for its baud rate; it
+//  wants a 16-bit unsigned int represented as a string. These are the rates
+//  it supports, slowest first, and the strings it recognizes as being the
+//  parameter for each of them.
+#define BAUD_RATES 8
+//  Both tables live in flash; baudAt() and baudCode() fetch from them.
+static const unsigned long baudRates[BAUD_RATES] PROGMEM =
+  {2400, 9600, 19200, 38400, 57600, 115200, 230400, 460800};
+static const char baudCodes[BAUD_RATES][5] PROGMEM =
+  {"000A", "0028", "004E", "009E", "00EB", "01D8", "03B0", "075F"};
+
+static unsigned long baudAt(byte i)
+{
+  return pgm_read_dword(&baudRates[i]);
+}
+
+static const __FlashStringHelper *baudCode(byte i)
+{
+  return (const __FlashStringHelper *)baudCodes[i];
+}
+
+// Turn one of the module's codes back into a rate. Returns 0 for a code we
+//  don't know.
+unsigned long BLEMate2::baudFromCode(const char *code)
+{
+  for (byte i = 0; i < BAUD_RATES; i++)
+  {
+    if (strcmp_P(code, baudCodes[i]) == 0) return baudAt(i);
+  }
+  return 0;
+}
+
+// Find a rate in the table. Returns 0xFF if it isn't there.
+static byte baudIndex(unsigned long speed)
+{
+  for (byte i = 0; i < BAUD_RATES; i++)
+  {
+    if (baudAt(i) == speed) return i;
+  }
+  return 0xFF;
+}
+
+// Change the baud rate. Doesn't take effect until write/reset cycle, so you
+//  can get the "OK" message after changing the setting.
+BLEMate2::opResult BLEMate2::setBaudRate(unsigned long newSpeed)
+{
+  byte i = baudIndex(newSpeed);
+  if (i == 0xFF) return INVALID_PARAM;
+
+  // Because this doesn't take effect until after a write/reset, stdSetParam()
+  //  works perfectly.
+  return stdSetParam(F("UART"), baudCode(i));
+}
+
+// Get the module and the Arduino talking as fast as they reliably can. First
+//  we find out what rate the module is at now, then we try each faster rate
+//  (up to maxBaud), fastest first, until one passes checkBaud(). Since the
+//  serial port belongs to the sketch, we need a function from it to change
+//  the Arduino's side: something like
+//    void setBaud(unsigned long baud) { Serial.end(); Serial.begin(baud); }
+//  This is a setup() kind of thing: it blocks, it takes a few seconds, and
+//  every rate change involves a writeConfig() and a reset(). If nothing
+//  faster works, we leave things at the rate we found.
+BLEMate2::opResult BLEMate2::autoBaud(baudSetter setter, unsigned long maxBaud)
+{
+  if (_polling) return BUSY_ERROR;
+  waitForIdle();
+  byte found = findBaud(setter);
+  if (found == 0xFF) return TIMEOUT_ERROR;
+
+  byte top = 0;
+  while (top + 1 < BAUD_RATES && baudAt(top + 1) <= maxBaud) top++;
+  for (byte i = top; i > found; i--)
   {
-    // Grow the current buffered data, until we receive the EOL string.    
-    if (_serialPort->available() >0)
+    if (moveBaud(setter, i) == SUCCESS && checkBaud() == SUCCESS)
     {
-      buffer.concat(char(_serialPort->read()));
+      return SUCCESS;
     }
-    if (buffer.endsWith(EOL))
+  }
+
+  // Nothing faster worked; put things back where we found them.
+  if (moveBaud(setter, found) != SUCCESS) return TIMEOUT_ERROR;
+  return checkBaud();
+}
+
+// The rate we believe the module and the Arduino are talking at, and the
+//  throughput (in bytes per second) checkBaud() saw there.
+unsigned long BLEMate2::getBaudRate()
+{
+  return _baudRate;
+}
+
+unsigned long BLEMate2::baudThroughput()
+{
+  return _baudThroughput;
+}
+
+// Try each rate the module supports, starting with the one we think it's at,
+//  until a bare "\r" gets an "ERR" back. Returns the index of the rate that
+//  worked, or 0xFF if none did.
+byte BLEMate2::findBaud(baudSetter setter)
+{
+  byte first = baudIndex(_baudRate);
+  for (byte n = 0; n <= BAUD_RATES; n++)
+  {
+    byte i = (n == 0) ? first : n - 1;
+    if (i >= BAUD_RATES || (n > 0 && i == first)) continue;
+    setter(baudAt(i));
+    _baudRate = baudAt(i);
+    if (probeBaud()) return i;
+  }
+  return 0xFF;
+}
+
+// This is the same trick the command engine uses to resync, done by hand:
+//  whatever's in the module's buffer gets purged by the "\r", and we get an
+//  ERR back. At the wrong rate, we'll get either nothing or garbage. On a
+//  marginal link, the probe itself can get mangled, so each rate gets a
+//  second chance.
+boolean BLEMate2::probeBaud()
+{
+  for (byte tries = 0; tries < 2; tries++)
+  {
+    delay(10);
+    while (_serialPort->available() > 0) readByte();
+    clearLine();
+    writeText("\r");
+    _serialPort->flush();
+
+    unsigned long start = millis();
+    while (millis() - start < 200)
     {
-      // There are several possibilities for return values:
-      //  1. ERR - indicates a problem with the module. Either we're in the
-      //           wrong state to be trying to do this (we're not central,
-      //           not idle, or both) or there's a syntax error.
-      //  2. Bluetooth Address xxxxxxxxxxxx - this is the one we want to
-      //           match. HOWEVER, there are *other* input strings after
-      //           issuing the VER command.
-      //  3. BlueCreation Copyright 2012-2014
-      //  4. www.bluecreation.com
-      //  5. Melody Smart vxxxxxxx
-      //  6. Build: xxxxxxxxx
-      //  7. OK
-      // The important string is number 2, and of course it comes last.
-      //  Thus, we want to discard any string that doesn't start with "Bluet".
-      //  We also need to return upon "OK".
-      if (buffer.startsWith("ER")) 
+      if (readLine() == LINE_ERR && strcmp_P(_lineBuf, PSTR("ERR")) == 0)
       {
-        return MODULE_ERROR;
-      }
-      if (buffer.startsWith("Bluet")) // The address has been found!
-      {
-        // The returned device string looks like this:
-        //  Bluetooth Address xxxxxxxxxxxx         
-        // We can ignore the other stuff, and the first stuff, and just
-        //  report the address. 
-        address = buffer.substring(18,30);
-        buffer = "";
-        result = SUCCESS;
-      }
-      else if (buffer.startsWith("OK"))
-      {
-        return result;
-      }
-      else // buffer is not a valid value
-      {
-        buffer = "";
+        _synced = true;
+        _owed = 0;
+        return true;
       }
     }
   }
-  // This command is always going to return TIMEOUT; the BC118 doesn't report
-  //  anything when it stops sending out data. It just...stops.
+  _synced = false;
+  return false;
+}
+
+// Get the module and the Arduino to the rate at index i, from wherever they
+//  are now. If the link is bad (which is why we'd be moving), any part of
+//  the move can fail, and the module could end up at either rate; so we
+//  look for it before each try.
+BLEMate2::opResult BLEMate2::moveBaud(baudSetter setter, byte i)
+{
+  for (byte tries = 0; tries < 3; tries++)
+  {
+    byte at = findBaud(setter);
+    if (at == 0xFF) return TIMEOUT_ERROR;
+    if (at == i) return SUCCESS;
+    if (switchBaud(setter, i) == SUCCESS) return SUCCESS;
+  }
   return TIMEOUT_ERROR;
 }
 
-// Change the baud rate. Doesn't take effect until write/reset cycle, so you
-//  can get the "OK" message after changing the setting.
-BLEMate2::opResult BLEMate2::setBaudRate(unsigned int newSpeed)
+// Move the module, and then the Arduino, to the rate at index i in the table.
+//  The RST goes out at the old rate; the module comes back up at the new one,
+//  so we change the Arduino's rate in between and catch the READY there.
+BLEMate2::opResult BLEMate2::switchBaud(baudSetter setter, byte i)
 {
-  // Temp for the string value you'll want to send out to the module.
-  String speedString = "";
+  opResult result = stdSetParam(F("UART"), baudCode(i));
+  if (result == SUCCESS) result = writeConfig();
+  if (result == SUCCESS) result = beginReset();
+  if (result != SUCCESS) return result;
+  setter(baudAt(i));
+  _baudRate = baudAt(i);
+  return waitForIdle();
+}
 
-  // The BC118 doesn't want a nice, human readable string; it wants a 16-bit
-  //  unsigned int represented as a string. 
-  // Here we'll convert things appropriately from the numeric speed input
-  //  (2400, 9600, 19200, 38400, 57600) to a string which the BC118 recognizes
-  //  as being the parameter for that string.
-  switch(newSpeed)
+// Is the link any good at this rate? We read the UART setting back a few
+//  times; every answer should be right, and we shouldn't have had to resync
+//  along the way. We time it while we're at it. Each round trip is 24 bytes:
+//  "GET UART\r" out, "UART=xxxx\n\rOK\n\r" back.
+BLEMate2::opResult BLEMate2::checkBaud()
+{
+  const byte rounds = 8;
+  String value;
+  unsigned int resyncs = _resyncCount;
+  unsigned long start = millis();
+  for (byte n = 0; n < rounds; n++)
   {
-    case 2400:
-      speedString = "000A";
-      break;
-    case 9600:
-      speedString = "0028";
-      break;
-    case 19200:
-      speedString = "004E";
-      break;
-    case 38400:
-      speedString = "009E";
-      break;
-    case 57600:
-      speedString = "00EB";
-      break;
-    default:
-      return INVALID_PARAM;
+    opResult result = stdGetParam(F("UART"), value);
+    if (result != SUCCESS) return result;
+    if (strcmp_P(value.c_str(), baudCodes[baudIndex(_baudRate)]) != 0)
+    {
+      return MODULE_ERROR;
+    }
   }
-
-  // Because this doesn't take effect until after a write/reset, stdSetParam()
-  //  works perfectly.
-  return stdSetParam("UART", speedString);
+  if (_resyncCount != resyncs) return MODULE_ERROR;
+  unsigned long elapsed = millis() - start;
+  if (elapsed == 0) elapsed = 1;
+  _baudThroughput = (rounds * 24UL * 1000UL) / elapsed;
+  return SUCCESS;
 }
 
 // There are several commands that look for either OK or ERROR; let's abstract
 //  support for those commands to one single private function, to save memory.
-BLEMate2::opResult BLEMate2::stdCmd(String command)
-{
-  String buffer;
-  String EOL = String("\n\r");
-  
-  knownStart(); // Clear the serial buffer in the module and the Arduino.
-  
-  _serialPort->print(command);
-  _serialPort->print("\r");
-  _serialPort->flush();
-  
-  // We're going to use the internal timer to track the elapsed time since we
-  //  issued the command. Bog-standard Arduino stuff.
-  unsigned long startTime = millis();
-    
-  // This is our timeout loop. We'll give the module 3 seconds.
-  while ((startTime + 3000) > millis())
-  {
-    // Grow the current buffered data, until we receive the EOL string.    
-    if (_serialPort->available() > 0) buffer.concat(char(_serialPort->read()));
+//  Each of these comes in three flavors: a plain C string, a string kept in
+//  flash with F(), and a String. The first two don't make any copies along
+//  the way, and F() keeps the text itself out of RAM altogether, so prefer
+//  those if RAM is tight.
+BLEMate2::opResult BLEMate2::stdCmd(const char *command)
+{
+  if (waitForRoom() != SUCCESS) return BUSY_ERROR;
+  return blockUntilDone(beginStdCmd(command));
+}
 
-    if (buffer.endsWith(EOL))
-    {
-      if (buffer.startsWith("ER")) return MODULE_ERROR;
-      if (buffer.startsWith("OK")) return SUCCESS;
-      buffer = "";
-    }    
-  }
-  return TIMEOUT_ERROR;
+BLEMate2::opResult BLEMate2::stdCmd(const __FlashStringHelper *command)
+{
+  if (waitForRoom() != SUCCESS) return BUSY_ERROR;
+  return blockUntilDone(beginStdCmd(command));
+}
+
+BLEMate2::opResult BLEMate2::stdCmd(const String &command)
+{
+  if (waitForRoom() != SUCCESS) return BUSY_ERROR;
+  return blockUntilDone(beginStdCmd(command));
+}
+
+// We'll give the module 3 seconds.
+BLEMate2::opResult BLEMate2::beginStdCmd(const char *command)
+{
+  return beginCmd(CMD_STD, 3000, NULL, ID_TEXT, command);
+}
+
+BLEMate2::opResult BLEMate2::beginStdCmd(const __FlashStringHelper *command)
+{
+  return beginCmd(CMD_STD, 3000, NULL, ID_TEXT, (const char *)command, NULL,
+                  FLASH_ARG1);
+}
+
+BLEMate2::opResult BLEMate2::beginStdCmd(const String &command)
+{
+  return beginStdCmd(command.c_str());
 }
 
 // Similar to the command function, let's do a set parameter genrealization.
-BLEMate2::opResult BLEMate2::stdSetParam(String command, String param)
-{
-  String buffer;
-  String EOL = String("\n\r");
-  
-  knownStart();  // Clear Arduino and module serial buffers.
-  
-  _serialPort->print("SET ");
-  _serialPort->print(command);
-  _serialPort->print("=");
-  _serialPort->print(param);
-  _serialPort->print("\r");
-  _serialPort->flush();
-  
-  // We're going to use the internal timer to track the elapsed time since we
-  //  issued the reset. Bog-standard Arduino stuff.
-  unsigned long startTime = millis();
-  
-  // This is our timeout loop. We'll give the module 2 seconds to reset.
-  while ((startTime + 2000) > millis())
-  {
-    // Grow the current buffered data, until we receive the EOL string.    
-    if (_serialPort->available() >0) buffer.concat(char(_serialPort->read()));
+BLEMate2::opResult BLEMate2::stdSetParam(const char *command,
+                                         const char *param)
+{
+  if (waitForRoom() != SUCCESS) return BUSY_ERROR;
+  return blockUntilDone(beginSetParam(command, param));
+}
 
-    if (buffer.endsWith(EOL))
-    {
-      if (buffer.startsWith("ER")) return MODULE_ERROR;
-      else if (buffer.startsWith("OK")) return SUCCESS;
-      buffer = "";
-    }    
-  }
-  return TIMEOUT_ERROR;
+BLEMate2::opResult BLEMate2::stdSetParam(const __FlashStringHelper *command,
+                                         const __FlashStringHelper *param)
+{
+  if (waitForRoom() != SUCCESS) return BUSY_ERROR;
+  return blockUntilDone(beginSetParam(command, param));
+}
+
+BLEMate2::opResult BLEMate2::stdSetParam(const String &command,
+                                         const String &param)
+{
+  if (waitForRoom() != SUCCESS) return BUSY_ERROR;
+  return blockUntilDone(beginSetParam(command, param));
+}
+
+// We'll give the module 2 seconds to respond.
+BLEMate2::opResult BLEMate2::beginSetParam(const char *command,
+                                           const char *param)
+{
+  return beginCmd(CMD_STD, 2000, NULL, ID_SET, command, param);
+}
+
+BLEMate2::opResult BLEMate2::beginSetParam(const __FlashStringHelper *command,
+                                           const __FlashStringHelper *param)
+{
+  return beginCmd(CMD_STD, 2000, NULL, ID_SET, (const char *)command,
+                  (const char *)param, FLASH_ARG1 | FLASH_ARG2);
+}
+
+BLEMate2::opResult BLEMate2::beginSetParam(const String &command,
+                                           const String &param)
+{
+  return beginSetParam(command.c_str(), param.c_str());
 }
 
 // Also, do a get paramater generalization. This is, of course, a bit more
 //  difficult; we need to return both the result (SUCCESS/ERROR) and the
 //  string returned.
-BLEMate2::opResult BLEMate2::stdGetParam(String command, String &param)
-{
-  String buffer;
-  String EOL = String("\n\r");
-  
-  knownStart();  // Clear the serial buffers.
-  
-  _serialPort->print("GET ");
-  _serialPort->print(command);
-  _serialPort->print("\r");
-  _serialPort->flush();
-  
-  // We're going to use the internal timer to track the elapsed time since we
-  //  issued the get command. Bog-standard Arduino stuff.
-  unsigned long loopStart = millis();
-  
-  // This is our timeout loop. We'll give the module 2 seconds to get the value.
-  while (loopStart + 2000 > millis())
-  {
-    // Grow the current buffered data, until we receive the EOL string.    
-    if (_serialPort->available() >0) buffer.concat(char(_serialPort->read()));
+BLEMate2::opResult BLEMate2::stdGetParam(const char *command, String &param)
+{
+  if (waitForRoom() != SUCCESS) return BUSY_ERROR;
+  return blockUntilDone(beginGetParam(command, param));
+}
 
-    // Each time we encounter an EOL, we'll parse the current buffer.
-    if (buffer.endsWith(EOL))
-    {
-      // ER and OK are simple enough- success or failure.
-      if (buffer.startsWith("ER")) return MODULE_ERROR;
-      if (buffer.startsWith("OK")) return SUCCESS;
-      // BUT if the buffer starts with the command value, we'll want to extract
-      //  the value returned by the module. As an example, "get ADDR" will 
-      //  cause the module to return with "ADDR=value\n\rOK\n\r"
-      if (buffer.startsWith(command))
-      {
-        // First, get the portion of the string beginning after the command
-        //  string + 1 (to account for that equals sign).
-        param = buffer.substring(command.length()+1);
-        // Then, trim the whitespace (/n/r) off the buffer.
-        param.trim();
-      }
-      buffer = "";
-    }    
-  }
-  // We don't expect this operation to take too long, so we can return a
-  //  timeout if we get here.
-  return TIMEOUT_ERROR;
+BLEMate2::opResult BLEMate2::stdGetParam(const __FlashStringHelper *command,
+                                         String &param)
+{
+  if (waitForRoom() != SUCCESS) return BUSY_ERROR;
+  return blockUntilDone(beginGetParam(command, param));
+}
+
+BLEMate2::opResult BLEMate2::stdGetParam(const String &command,
+                                         String &param)
+{
+  if (waitForRoom() != SUCCESS) return BUSY_ERROR;
+  return blockUntilDone(beginGetParam(command, param));
+}
+
+// We'll give the module 2 seconds to get the value.
+BLEMate2::opResult BLEMate2::beginGetParam(const char *command,
+                                           String &param)
+{
+  return beginCmd(CMD_GET, 2000, &param, ID_GET, command);
+}
+
+BLEMate2::opResult BLEMate2::beginGetParam(const __FlashStringHelper *command,
+                                           String &param)
+{
+  return beginCmd(CMD_GET, 2000, &param, ID_GET, (const char *)command, NULL,
+                  FLASH_ARG1);
+}
+
+BLEMate2::opResult BLEMate2::beginGetParam(const String &command,
+                                           String &param)
+{
+  return beginGetParam(command.c_str(), param);
 }
 
 // Function to put the module into BLE Central Mode.
 BLEMate2::opResult BLEMate2::BLECentral()
 {
-  return stdSetParam("CENT", "ON");
+  return stdSetParam(F("CENT"), F("ON"));
 }
 
 BLEMate2::opResult BLEMate2::BLEPeripheral()
 {
-  return stdSetParam("CENT", "OFF");
+  return stdSetParam(F("CENT"), F("OFF"));
 }
 
 // Issue the "RESTORE" command over the serial port to the BC118. This will
@@ -272,7 +477,13 @@ BLEMate2::opResult BLEMate2::BLEPeripheral()
 //  once in a while.
 BLEMate2::opResult BLEMate2::restore()
 {
-  return stdCmd("RTR");
+  if (waitForRoom() != SUCCESS) return BUSY_ERROR;
+  return blockUntilDone(beginRestore());
+}
+
+BLEMate2::opResult BLEMate2::beginRestore()
+{
+  return beginStdCmd(F("RTR"));
 }
 
 // Issue the "WRITE" command over the serial port to the BC118. This will
@@ -280,10 +491,16 @@ BLEMate2::opResult BLEMate2::restore()
 //  or power cycle.
 BLEMate2::opResult BLEMate2::writeConfig()
 {
-  return stdCmd("WRT");
+  if (waitForRoom() != SUCCESS) return BUSY_ERROR;
+  return blockUntilDone(beginWriteConfig());
+}
+
+BLEMate2::opResult BLEMate2::beginWriteConfig()
+{
+  return beginStdCmd(F("WRT"));
 }
 
-// Issue the "RESET" command over the serial port to the BC118. If it works, 
+// Issue the "RESET" command over the serial port to the BC118. If it works,
 //  we expect to see a string that looks something like this:
 //    Melody Smart v2.6.0
 //    BlueCreation Copyright 2012 - 2014
@@ -291,221 +508,481 @@ BLEMate2::opResult BLEMate2::writeConfig()
 //    READY
 // If there is some sort of error, the module will respond with
 //    ERR
-// We'll buffer characters until we see an EOL (\n\r), then check the string.
+// Once we see READY, we follow up with "SCN OFF", since coming out of reset
+//  we *could* be in scan mode, and that's too random and noisy to live with.
 BLEMate2::opResult BLEMate2::reset()
 {
-  String buffer;
-  String EOL = String("\n\r");
-  
-  knownStart();
-  
-  // Now issue the reset command.
-  _serialPort->print("RST");
-  _serialPort->print("\r");
-  _serialPort->flush();
-  
-  // We're going to use the internal timer to track the elapsed time since we
-  //  issued the reset. Bog-standard Arduino stuff.
-  unsigned long resetStart = millis();
-  
-  // This is our timeout loop. We'll give the module 6 seconds to reset.
-  while ((resetStart + 6000) > millis())
+  if (waitForRoom() != SUCCESS) return BUSY_ERROR;
+  return blockUntilDone(beginReset());
+}
+
+BLEMate2::opResult BLEMate2::beginReset()
+{
+  // We'll give the module 6 seconds to reset.
+  cmdEntry *cmd = newCommand(CMD_RESET, 6000);
+  if (cmd == NULL) return BUSY_ERROR;
+  buildCmd(cmd, ID_RST);
+  return queueCommand(cmd);
+}
+
+// Everything the BC118 sends us comes in lines terminated by "\n\r". Rather
+//  than growing a String one character at a time and checking it for an EOL
+//  on every pass through a loop, we assemble lines into a fixed buffer here.
+//  This only does work when there's a character waiting, and returns as soon
+//  as it completes a line, so the caller can deal with that line before the
+//  next one starts. The line is left in _lineBuf, null terminated and with
+//  the EOL stripped, until the next call.
+BLEMate2::lineType BLEMate2::readLine()
+{
+  // If we handed back a line last time, this is the start of a new one.
+  if (_lineReady) clearLine();
+
+  while (_serialPort->available() > 0)
   {
-    // Grow the current buffered data, until we receive the EOL string.    
-    if (_serialPort->available() > 0) 
+    char c = readByte();
+    _lastRxTime = millis();
+
+    // "\r" only ends a line when it follows "\n". If the "\n" made it into
+    //  the buffer, drop it before we report the line.
+    if (c == '\r' && _lineLen > 0 && _lineBuf[_lineLen-1] == '\n')
     {
-      char temp = _serialPort->read();
-      buffer.concat(temp);
+      _lineLen--;
+      _lineBuf[_lineLen] = '\0';
+      _lineReady = true;
+      return classifyLine();
     }
-    
-    if (buffer.endsWith(EOL))
+
+    // Leave room for the terminator. If the line is too long, we keep
+    //  looking for the EOL but only keep the last character, which will
+    //  let us spot a "\n" arriving just before the "\r".
+    if (_lineLen < BLE_MATE2_LINE_SIZE - 1)
     {
-      // If ERR or READY, we've finished the reset. Otherwise, just discard
-      //  the data and wait for the next EOL.
-      if (buffer.startsWith("ER")) return MODULE_ERROR;
-      if (buffer.startsWith("RE")) 
-      {
-        stdCmd("SCN OFF"); // When we come out of reset, we *could* be
-                           //  in scan mode. We don't want that; it's too
-                           //  random and noisy.
-        delay(500);        // Let the scanning noise complete.
-        while(_serialPort->available())
-        {
-          _serialPort->read();
-        } 
-        return SUCCESS;
-      }
-      buffer = "";
-    }    
+      _lineBuf[_lineLen++] = c;
+    }
+    else
+    {
+      _lineOverflow = true;
+      _synced = false;
+      _lineBuf[BLE_MATE2_LINE_SIZE - 2] = c;
+    }
   }
-  return TIMEOUT_ERROR;
+  return LINE_NONE;
 }
 
-// Create a known state for the module to start from. If a partial command is
-//  already in the module's buffer, we can purge it by sending an EOL to the
-//  the module. If not, we'll just get an error.
-BLEMate2::opResult BLEMate2::knownStart()
-{
-  String EOL = String("\n\r");
-  String buffer = "";
-  
-  _serialPort->print("\r");
-  _serialPort->flush();
-  
-  // We're going to use the internal timer to track the elapsed time since we
-  //  issued the reset. Bog-standard Arduino stuff.
-  unsigned long startTime = millis();
-  
-  // This is our timeout loop. We're going to give our module 1s to come up
-  //  with a new character, and return with a timeout failure otherwise.
-  while (buffer.endsWith(EOL) != true)
+// Sort a completed line by the prefix the module gave it.
+BLEMate2::lineType BLEMate2::classifyLine()
+{
+  if (lineStartsWith(PSTR("OK")))   return LINE_OK;
+  if (lineStartsWith(PSTR("ERR")))  return LINE_ERR;
+  if (lineStartsWith(PSTR("RCV="))) return LINE_RCV;
+  if (lineStartsWith(PSTR("SCN="))) return LINE_SCN;
+  if (lineStartsWith(PSTR("STS")))  return LINE_STS;
+  if (lineStartsWith(PSTR("RPD")))  return LINE_RPD;
+  if (lineStartsWith(PSTR("DCN")))  return LINE_DCN;
+  return LINE_OTHER;
+}
+
+// The prefix has to be in flash; use PSTR().
+boolean BLEMate2::lineStartsWith(const char *prefix)
+{
+  return strncmp_P(_lineBuf, prefix, strlen_P(prefix)) == 0;
+}
+
+void BLEMate2::clearLine()
+{
+  _lineLen = 0;
+  _lineBuf[0] = '\0';
+  _lineReady = false;
+  _lineOverflow = false;
+}
+
+// Everything we say to the module and hear from it goes through these, so
+//  there's one place to count it (and trace it).
+void BLEMate2::writeText(const char *text)
+{
+#if BLE_MATE2_TRACE_SIZE > 0
+  for (const char *p = text; *p != '\0'; p++) traceByte(true, *p);
+#endif
+#if BLE_MATE2_STATS
+  _stats.bytesOut += _serialPort->print(text);
+#else
+  _serialPort->print(text);
+#endif
+}
+
+void BLEMate2::writeText(const __FlashStringHelper *text)
+{
+#if BLE_MATE2_TRACE_SIZE > 0
+  const char *p = (const char *)text;
+  for (byte c = pgm_read_byte(p); c != '\0'; c = pgm_read_byte(++p))
   {
-    // Purge the serial data received from the module, along with any data in
-    //  the buffer at the time this command was sent.
-    if (_serialPort->available() > 0) 
-    {
-      buffer.concat(char(_serialPort->read()));
-      startTime = millis();
-    }
-    if ((startTime + 1000) < millis()) return TIMEOUT_ERROR;
+    traceByte(true, c);
   }
-  if (buffer.startsWith("ERR")) return SUCCESS;
-  else return SUCCESS;
+#endif
+#if BLE_MATE2_STATS
+  _stats.bytesOut += _serialPort->print(text);
+#else
+  _serialPort->print(text);
+#endif
+}
+
+void BLEMate2::writeBytes(const uint8_t *data, size_t len)
+{
+  _serialPort->write(data, len);
+#if BLE_MATE2_STATS
+  _stats.bytesOut += len;
+#endif
+#if BLE_MATE2_TRACE_SIZE > 0
+  for (size_t i = 0; i < len; i++) traceByte(true, data[i]);
+#endif
 }
 
-// For sendData, we have three possible options that we'll consider.
+int BLEMate2::readByte()
+{
+#if BLE_MATE2_STATS
+  _stats.bytesIn++;
+#endif
+#if BLE_MATE2_TRACE_SIZE > 0
+  int c = _serialPort->read();
+  if (c >= 0) traceByte(false, c);
+  return c;
+#else
+  return _serialPort->read();
+#endif
+}
+
+// For sendData, we have five possible options that we'll consider.
 //  1. User wants to send a constant string.
 //  2. User wants to send a variable string, encoded as a String object.
 //  3. User wants to send an array of characters.
-// From a data standpoint, 1 and 2 are just subsets of three, so we'll
-//  write most of the functionality into 3 and call it from 2, and call
-//  2 from 1.
+//  4. User wants to send whatever comes out of a Stream (a file, say).
+//  5. User wants us to ask a function for the data, a piece at a time.
+// From a data standpoint, 1 and 2 are just subsets of three, so they both
+//  hand their characters straight to 3. There's no need to copy anything:
+//  the blocking call doesn't return until the data is out on the wire, and
+//  sendChunk() writes it out of the caller's buffer. Note that we don't send
+//  the null terminator. 4 and 5 are for things too big to have in RAM all at
+//  once; those get pulled into _sendBuf one chunk at a time.
 BLEMate2::opResult BLEMate2::sendData(const char *dataBuffer)
 {
-  String newBuffer = dataBuffer;
-  return sendData(newBuffer);
+  return sendData(dataBuffer, strlen(dataBuffer));
 }
 
-BLEMate2::opResult BLEMate2::sendData(String &dataBuffer)
+BLEMate2::opResult BLEMate2::sendData(const String &dataBuffer)
 {
-  // First, we'll need to figure out the length of the string.
-  int bufLength = dataBuffer.length()+1;
+  return sendData(dataBuffer.c_str(), dataBuffer.length());
+}
 
-  // Now dynamically allocate an array of the appropriate size.
-  char *charArray = new char [bufLength];
+// Now, byte array.
+BLEMate2::opResult BLEMate2::sendData(const char *dataBuffer, size_t dataLen)
+{
+  if (waitForRoom() != SUCCESS) return BUSY_ERROR;
+  return blockUntilDone(beginSendData(dataBuffer, dataLen));
+}
+
+// Stream source. We'll send up to dataLen bytes, or until the Stream says it
+//  has nothing more available, whichever comes first.
+BLEMate2::opResult BLEMate2::sendData(Stream &source, size_t dataLen)
+{
+  if (waitForRoom() != SUCCESS) return BUSY_ERROR;
+  return blockUntilDone(beginSendData(source, dataLen));
+}
 
-  // Copy over the data.
-  dataBuffer.toCharArray(charArray, bufLength);
+// Function source. The function gets a buffer and the most it may put in it,
+//  and returns how much it did put in it; returning 0 ends the send.
+BLEMate2::opResult BLEMate2::sendData(dataSource source)
+{
+  if (waitForRoom() != SUCCESS) return BUSY_ERROR;
+  return blockUntilDone(beginSendData(source));
+}
 
-  // Call the byte array function
-  opResult result = sendData(charArray, bufLength);
+// BLE is a super low bandwidth protocol. The BC118 is only going to allow
+//  you to drop 20 bytes in central mode, or 125 bytes in peripheral mode.
+//  I don't want to burden the user with that, unduly, so I'm going to chop
+//  up their data and send it out in smaller blocks. Thus, the first question
+//  is: am I in central mode, or not? We used to ask with STS every single
+//  time, which for small packets was most of the cost of sending them. Now
+//  we remember the answer (see noteStatus()) and only ask when we don't know.
+//  The rest happens in sendChunk() as each OK comes back.
+//
+// Only one SND is ever on the wire at a time: the next chunk goes out when
+//  the module OKs the last one. That's what keeps us from overrunning the
+//  module's buffer, and it means that when a chunk gets an ERR, we can send
+//  it again without the data getting out of order.
+BLEMate2::opResult BLEMate2::beginSendData(const char *dataBuffer,
+                                           size_t dataLen)
+{
+  // Each chunk gets 3 seconds.
+  cmdEntry *cmd = newCommand(CMD_SEND, 3000);
+  if (cmd == NULL) return BUSY_ERROR;
+  cmd->out.data = dataBuffer;
+  cmd->arg = dataLen;
+  cmd->source = SOURCE_BUFFER;
+  return queueCommand(cmd);
+}
 
-  // de-allocate the memory.
-  delete charArray;
+BLEMate2::opResult BLEMate2::beginSendData(Stream &source, size_t dataLen)
+{
+  cmdEntry *cmd = newCommand(CMD_SEND, 3000);
+  if (cmd == NULL) return BUSY_ERROR;
+  cmd->out.stream = &source;
+  cmd->arg = dataLen;
+  cmd->source = SOURCE_STREAM;
+  return queueCommand(cmd);
+}
 
-  return result;
+BLEMate2::opResult BLEMate2::beginSendData(dataSource source)
+{
+  cmdEntry *cmd = newCommand(CMD_SEND, 3000);
+  if (cmd == NULL) return BUSY_ERROR;
+  cmd->out.source = source;
+  cmd->arg = 0xFFFFFFFF; // No limit; the function says when it's done.
+  cmd->source = SOURCE_FUNCTION;
+  return queueCommand(cmd);
 }
 
-// Now, byte array.
-BLEMate2::opResult BLEMate2::sendData(char *dataBuffer, byte dataLen)
-{
-  String EOL = String("\n\r");
-  
-  // BLE is a super low bandwidth protocol. The BC118 is only going to allow
-  //  you to drop 20 bytes in central mode, or 125 bytes in peripheral mode.
-  //  I don't want to burden the user with that, unduly, so I'm going to chop
-  //  up their data and send it out in smaller blocks.
-   
-  // Thus, the first quetion is: am I in central mode, or not?
-  boolean inCentralMode;
-  amCentral(inCentralMode);
-
-  // What we're now going to do is to build a String object with our buffer
-  //  contents and then hit send on that buffer when it reaches a the length
-  //  limited by the mode.
-
-  byte outBufLenLimit = 20;
-  if (!inCentralMode)
+// Line up the next piece of the user's data in _cmdChunkLen (and, for Stream
+//  and function sources, in _sendBuf). Returns false if there's nothing
+//  left to send.
+boolean BLEMate2::nextChunk(cmdEntry *cmd)
+{
+  // If STS didn't tell us anything, 20 bytes is safe either way.
+  unsigned long chunkSize = (_role == ROLE_PERIPHERAL) ? 125 : 20;
+  if (cmd->source != SOURCE_BUFFER && chunkSize > BLE_MATE2_SEND_CHUNK)
   {
-    outBufLenLimit = 125;
+    chunkSize = BLE_MATE2_SEND_CHUNK;
   }
+  if (chunkSize > cmd->arg - _cmdDataPos) chunkSize = cmd->arg - _cmdDataPos;
 
-  byte inBufPtr = 0;
-  byte outBufLen = 0;
-  byte dataLeft = dataLen;
+  _cmdChunkLen = 0;
+  _cmdRetries = 0;
+  if (cmd->source == SOURCE_BUFFER)
+  {
+    _cmdChunkLen = chunkSize;
+  }
+  else if (cmd->source == SOURCE_STREAM)
+  {
+    while (_cmdChunkLen < chunkSize && cmd->out.stream->available() > 0)
+    {
+      _sendBuf[_cmdChunkLen++] = cmd->out.stream->read();
+    }
+  }
+  else if (chunkSize > 0)
+  {
+    _cmdChunkLen = cmd->out.source(_sendBuf, chunkSize);
+    if (_cmdChunkLen > chunkSize) _cmdChunkLen = chunkSize;
+  }
+  return _cmdChunkLen > 0;
+}
 
-  opResult result = SUCCESS;
-  while (inBufPtr < dataLen)
+// Send the current piece of the user's data. The "SND " prefix, the slice of
+//  the user's buffer and the terminator all go straight to the serial port,
+//  so no copy of the data is ever made. In the first phase, we haven't sent
+//  anything yet; if we don't know the mode, we ask about it first. If there
+//  turns out to be nothing to send, we ask anyway, just to have an OK to
+//  finish on.
+void BLEMate2::sendChunk(cmdEntry *cmd)
+{
+  if (cmd->phase == PHASE_FIRST)
   {
-    if (dataLeft < outBufLenLimit)
+    _cmdDataPos = 0;
+    _cmdStart = millis();
+    if (_role == ROLE_UNKNOWN || !nextChunk(cmd))
     {
-      outBufLenLimit = dataLeft;
+      writeText(F("STS\r"));
+      return;
     }
-    dataLeft -= outBufLenLimit;
-    String outBuf;
-    while (outBufLen < outBufLenLimit)
+    cmd->phase = PHASE_SECOND;
+  }
+
+  writeText(F("SND "));
+  if (cmd->source == SOURCE_BUFFER)
+  {
+    writeBytes((const uint8_t *)&cmd->out.data[_cmdDataPos], _cmdChunkLen);
+  }
+  else
+  {
+    writeBytes((const uint8_t *)_sendBuf, _cmdChunkLen);
+  }
+  writeText("\r");
+}
+
+// Wrap up a send, noting how quickly it went.
+void BLEMate2::finishSend(opResult result)
+{
+  unsigned long elapsed = millis() - _cmdStart;
+  if (elapsed == 0) elapsed = 1;
+  _sendRate = (_cmdDataPos * 1000UL) / elapsed;
+  finishCommand(result);
+}
+
+// Bytes per second achieved by the last send, from the first byte out to the
+//  last OK back. Slow numbers here with a climbing retransmitCount() mean the
+//  module (or the link) is struggling to keep up.
+unsigned long BLEMate2::sendRate()
+{
+  return _sendRate;
+}
+
+// The number of chunks we've had to send twice because the module answered
+//  them with ERR.
+unsigned int BLEMate2::retransmitCount()
+{
+  return _retransmits;
+}
+
+// Called by poll() with an RCV= line in the line buffer. Everything after the
+//  "RCV=" is data from the remote device, and it goes to the onData()
+//  function if there is one, or into the receive buffer if not. Nothing else
+//  the module says ever ends up there. If a line was too long for the line
+//  buffer, we don't know what we lost, so we drop it.
+void BLEMate2::receiveData()
+{
+  if (_lineOverflow) return;
+  if (_dataCallback != NULL)
+  {
+    _dataCallback(&_lineBuf[4], _lineLen - 4);
+    return;
+  }
+  for (byte i = 4; i < _lineLen; i++)
+  {
+    if (_rxCount >= BLE_MATE2_RX_SIZE)
     {
-      outBuf.concat(dataBuffer[inBufPtr++]);
-      outBufLen++;
+      _rxOverflows += _lineLen - i;
+      return;
     }
-    outBuf = "SND " + outBuf + "\r";
-    result = stdCmd(outBuf);
-    outBufLen = 0;
+    _rxBuf[(_rxHead + _rxCount++) % BLE_MATE2_RX_SIZE] = _lineBuf[i];
   }
-  return result;
+}
+
+// The Stream functions. If the receive buffer is empty, we give poll() a
+//  chance to find something for it, so a loop that does nothing but check
+//  available() will still see data arrive.
+int BLEMate2::available()
+{
+  if (_rxCount == 0) poll();
+  return _rxCount;
+}
+
+int BLEMate2::read()
+{
+  if (available() == 0) return -1;
+  char c = _rxBuf[_rxHead];
+  _rxHead = (_rxHead + 1) % BLE_MATE2_RX_SIZE;
+  _rxCount--;
+  return (byte)c;
+}
+
+int BLEMate2::peek()
+{
+  if (available() == 0) return -1;
+  return (byte)_rxBuf[_rxHead];
+}
+
+// Read as much as we have, up to len bytes, without waiting for more.
+//  Returns the number of bytes read.
+size_t BLEMate2::read(char *buffer, size_t len)
+{
+  if (len > (size_t)available()) len = _rxCount;
+  for (size_t i = 0; i < len; i++)
+  {
+    buffer[i] = _rxBuf[_rxHead];
+    _rxHead = (_rxHead + 1) % BLE_MATE2_RX_SIZE;
+  }
+  _rxCount -= len;
+  return len;
+}
+
+// Writes are all blocking, so by the time one returns, it's out. The only
+//  thing left to wait for is whatever's still in the command queue.
+void BLEMate2::flush()
+{
+  while (busy())
+  {
+    poll();
+  }
+}
+
+size_t BLEMate2::write(uint8_t c)
+{
+  return (sendData((const char *)&c, 1) == SUCCESS) ? 1 : 0;
+}
+
+size_t BLEMate2::write(const uint8_t *buffer, size_t size)
+{
+  return (sendData((const char *)buffer, size) == SUCCESS) ? size : 0;
+}
+
+// The number of received bytes we've had to throw away because the receive
+//  buffer was full. If this is going up, read more often, or make
+//  BLE_MATE2_RX_SIZE bigger.
+unsigned int BLEMate2::rxOverflowCount()
+{
+  return _rxOverflows;
 }
 
 // We may at some point not know whether we're a central or peripheral
 //  device; that's important information, so we should be able to query
-//  the module regarding that. We're not going to store that info, however, 
-//  since the whole point is to get it "from the horse's mouth" rather than
-//  trusting that our software is in sync with the state of the module.
+//  the module regarding that. This always asks the module, since the whole
+//  point is to get it "from the horse's mouth" rather than trusting that our
+//  software is in sync with the state of the module. The answer does update
+//  what sendData() believes, though.
 BLEMate2::opResult BLEMate2::amCentral(boolean &inCentralMode)
 {
-  String buffer;
-  String EOL = String("\n\r");
-  
-  knownStart(); // Clear the serial buffer in the module and the Arduino.
-  
-  _serialPort->print("STS\r");
-  _serialPort->flush();
-  
-  // We're going to use the internal timer to track the elapsed time since we
-  //  issued the command. Bog-standard Arduino stuff.
-  unsigned long startTime = millis();
-    
-  // This is our timeout loop. We'll give the module 3 seconds.
-  while ((startTime + 3000) > millis())
+  if (waitForRoom() != SUCCESS) return BUSY_ERROR;
+  return blockUntilDone(beginAmCentral(inCentralMode));
+}
+
+BLEMate2::opResult BLEMate2::beginAmCentral(boolean &inCentralMode)
+{
+  // We'll give the module 3 seconds.
+  cmdEntry *cmd = newCommand(CMD_STATUS, 3000);
+  if (cmd == NULL) return BUSY_ERROR;
+  cmd->out.flag = &inCentralMode;
+  buildCmd(cmd, ID_STS);
+  return queueCommand(cmd);
+}
+
+// sendData() keeps track of the module's role (and with it, how much data
+//  fits in one SND) from what it sees go by: BLECentral()/BLEPeripheral()
+//  and any other "SET CENT", resets and restores, and every STS line the
+//  module sends us, asked for or not. If you don't trust that, this asks the
+//  module outright and updates our idea of things.
+BLEMate2::opResult BLEMate2::refreshState()
+{
+  if (waitForRoom() != SUCCESS) return BUSY_ERROR;
+  return blockUntilDone(beginRefreshState());
+}
+
+BLEMate2::opResult BLEMate2::beginRefreshState()
+{
+  cmdEntry *cmd = newCommand(CMD_STATUS, 3000);
+  if (cmd == NULL) return BUSY_ERROR;
+  cmd->out.flag = NULL;
+  buildCmd(cmd, ID_STS);
+  return queueCommand(cmd);
+}
+
+// Called with an STS line in the line buffer. The character after "STS " is
+//  'C' for central, 'P' for peripheral.
+void BLEMate2::noteStatus()
+{
+  if (_lineLen < 5) return;
+  _role = (_lineBuf[4] == 'C') ? ROLE_CENTRAL : ROLE_PERIPHERAL;
+}
+
+// Called when a plain OK/ERR command succeeds, to catch the ones that change
+//  the module's role. "SET CENT=" takes effect as far as STS is concerned
+//  right away; a restore puts it back to a default we'd rather ask about.
+void BLEMate2::noteCommand(cmdEntry *cmd)
+{
+  if (strncmp_P(cmd->text, PSTR("SET CENT="), 9) == 0)
   {
-    // Grow the current buffered data, until we receive the EOL string.    
-    if (_serialPort->available() > 0) 
-    {
-      buffer.concat(char(_serialPort->read()));
-    }
-    if (buffer.endsWith(EOL))
-    {
-      if (buffer.startsWith("ER")) 
-      {
-        return MODULE_ERROR;
-      }
-      else if (buffer.startsWith("OK")) 
-      {
-        return SUCCESS;
-      }
-      else if (buffer.startsWith("STS")) 
-      {
-        if (buffer.charAt(4) == 'C')
-        {
-          inCentralMode = true;
-        }
-        else
-        {
-          inCentralMode = false;
-        }
-      } 
-      buffer = "";
-    }    
+    _role = (strcmp_P(&cmd->text[9], PSTR("ON")) == 0) ? ROLE_CENTRAL :
+                                                          ROLE_PERIPHERAL;
+  }
+  else if (strcmp_P(cmd->text, PSTR("RTR")) == 0)
+  {
+    _role = ROLE_UNKNOWN;
   }
-  return TIMEOUT_ERROR;
 }
-
@@ -19,12 +19,204 @@ Code developed in Arduino 1.0.6, on an Arduino Pro 5V.
 
 #include <Arduino.h>
 
-class BLEMate2
+// Size of the buffer used to assemble incoming lines from the module. The
+//  longest thing the BC118 sends us is an RCV= line carrying a full 125-byte
+//  peripheral payload, so that sets the default. Anything longer than this
+//  is truncated (and flagged as such) rather than overrunning the buffer.
+//  The length is tracked in a byte, so keep this under 256.
+#ifndef BLE_MATE2_LINE_SIZE
+#define BLE_MATE2_LINE_SIZE 136
+#endif
+
+// Size of the buffer that holds a command's text until it can go out on the
+//  wire. "SET ADDR=000000000000" is about the longest thing we build, but
+//  stdCmd() and friends will take whatever the user hands them, so leave a
+//  little headroom.
+#ifndef BLE_MATE2_CMD_SIZE
+#define BLE_MATE2_CMD_SIZE 32
+#endif
+
+// Number of commands that can be waiting in the queue (including the ones on
+//  the wire). Each slot costs a little more than BLE_MATE2_CMD_SIZE bytes of
+//  RAM.
+#ifndef BLE_MATE2_QUEUE_SIZE
+#define BLE_MATE2_QUEUE_SIZE 4
+#endif
+
+// Size of the buffer that data from a Stream or a function is pulled into on
+//  its way out (data from a plain buffer is sent straight from there). 125
+//  bytes is the most the BC118 takes in one go as a peripheral; if you only
+//  ever send as a central, 20 is all you need.
+#ifndef BLE_MATE2_SEND_CHUNK
+#define BLE_MATE2_SEND_CHUNK 125
+#endif
+
+// How many times to send a chunk of data again when the module answers it
+//  with ERR, before giving up on the send.
+#ifndef BLE_MATE2_SEND_RETRIES
+#define BLE_MATE2_SEND_RETRIES 2
+#endif
+
+// Size of the buffer that holds data received from the remote device until
+//  the application reads it. If the application falls behind, new data is
+//  dropped (and counted; see rxOverflowCount()).
+#ifndef BLE_MATE2_RX_SIZE
+#define BLE_MATE2_RX_SIZE 64
+#endif
+
+// Number of devices the scan table can hold. Each one costs 13 bytes of RAM.
+//  When it fills up, setScanPolicy() decides which device gets left out.
+//  Keep this under 255.
+#ifndef BLE_MATE2_SCAN_SIZE
+#define BLE_MATE2_SCAN_SIZE 8
+#endif
+
+// Room for the module's name in a BLEMate2Config, including the terminating
+//  null. The BC118 won't take a name longer than 20 characters.
+#ifndef BLE_MATE2_NAME_SIZE
+#define BLE_MATE2_NAME_SIZE 21
+#endif
+
+// The shortest deadline adaptDeadlines() will ever set, in milliseconds.
+//  Command latency from one run to the next can be very steady, and a
+//  deadline that hugs it too closely turns one hiccup into a timeout and a
+//  resync.
+#ifndef BLE_MATE2_DEADLINE_FLOOR
+#define BLE_MATE2_DEADLINE_FLOOR 50
+#endif
+
+// Set this to 1 to have the library keep count of what it's doing: how many
+//  of each kind of command it's sent, how long they took and how they went,
+//  bytes in and out, and so on. See getStats(). Left at 0, none of that code
+//  or data is compiled in.
+#ifndef BLE_MATE2_STATS
+#define BLE_MATE2_STATS 0
+#endif
+
+// Set this to a number of bytes (256, say) to keep a trace of the most recent
+//  traffic with the module, every byte each way with its time, for when
+//  something goes wrong in the field. Each byte takes two bytes of trace, so
+//  256 holds the last 128 or so. See dumpTrace(). Left at 0, none of that
+//  code or data is compiled in.
+#ifndef BLE_MATE2_TRACE_SIZE
+#define BLE_MATE2_TRACE_SIZE 0
+#endif
+
+// The module settings we usually care about, in a form that's easier to deal
+//  with than the strings the module uses for them. See readConfig() and
+//  applyConfig().
+struct BLEMate2Config
+{
+  unsigned long baudRate;          // UART
+  boolean central;                 // CENT
+  boolean autoConnect;             // ACON: connect to the first BC118 found
+  boolean advertiseOnDisconnect;   // CCON
+  unsigned int scanTimeout;        // SCNT, in seconds; 0 is forever
+  boolean fastAdvertising;         // ADVP: FAST or SLOW
+  unsigned int advertiseTimeout;   // ADVT, in seconds; 0 is forever
+  byte allowAddress[6];            // ADDR: who may connect; all 0 is anyone
+  char name[BLE_MATE2_NAME_SIZE];  // NAME
+};
+
+class BLEMate2 : public Stream
 {
   public:
     // Now, make a data type for function results.
-    enum opResult {REMOTE_ERROR = -5, CONNECT_ERROR, INVALID_PARAM,
-                 TIMEOUT_ERROR, MODULE_ERROR, DEFAULT_ERR, SUCCESS};
+    //  BUSY_ERROR means a begin*() function was called while the command
+    //  queue was full; ABORTED_ERROR means a command was dropped because an
+    //  earlier one in its batch failed. IN_PROGRESS is what lastResult()
+    //  reports while a command is under way.
+    enum opResult {ABORTED_ERROR = -7, BUSY_ERROR, REMOTE_ERROR, CONNECT_ERROR,
+                 INVALID_PARAM, TIMEOUT_ERROR, MODULE_ERROR, DEFAULT_ERR,
+                 SUCCESS, IN_PROGRESS};
+
+    // Signature for the function called when a command completes.
+    typedef void (*opCallback)(opResult result);
+
+    // Signature for a function that supplies data to sendData(): fill in up
+    //  to maxLen bytes of buffer and return how many you filled in, or 0 when
+    //  there's no more.
+    typedef size_t (*dataSource)(char *buffer, size_t maxLen);
+
+    // Signatures for the functions called when the module tells us something
+    //  we didn't ask about. See onConnect() and friends.
+    typedef void (*eventCallback)();
+    typedef void (*addressCallback)(const char *address);
+    typedef void (*dataCallback)(const char *data, byte len);
+
+    // Signature for the function autoBaud() uses to change the Arduino's end
+    //  of the serial link.
+    typedef void (*baudSetter)(unsigned long baud);
+
+    // The kinds of command the engine knows how to see through. Each one
+    //  differs in what it sends and in which lines finish it off. These are
+    //  only public so that the statistics can be broken down by them.
+    enum cmdType {CMD_NONE, CMD_STD, CMD_GET, CMD_STATUS, CMD_VERSION,
+                  CMD_RESET, CMD_SCAN, CMD_CONNECT, CMD_DISCONNECT, CMD_SEND,
+                  CMD_CONFIG, CMD_TYPES};
+
+    // The settings in a BLEMate2Config, one bit each in what diffConfig()
+    //  returns.
+    enum configField {CONFIG_UART, CONFIG_CENT, CONFIG_ACON, CONFIG_CCON,
+                      CONFIG_SCNT, CONFIG_ADVP, CONFIG_ADVT, CONFIG_ADDR,
+                      CONFIG_NAME, CONFIG_FIELDS};
+
+#if BLE_MATE2_STATS
+    // Statistics for one kind of command. Times are in milliseconds, from
+    //  when the command went out on the wire to when it finished; aborted
+    //  commands are counted, but never went out, so only the timed ones go
+    //  into the times.
+    struct cmdStats
+    {
+      unsigned int count;
+      unsigned int timed;
+      unsigned int errors;
+      unsigned int timeouts;
+      unsigned long minTime;
+      unsigned long maxTime;
+      unsigned long totalTime;
+    };
+
+    // Everything getStats() reports. unsolicited counts lines from the
+    //  module that nothing (no command and no event) had any use for.
+    struct stats
+    {
+      cmdStats cmd[CMD_TYPES];
+      unsigned long bytesOut;
+      unsigned long bytesIn;
+      unsigned int unsolicited;
+      unsigned int resyncs;
+    };
+#endif
+
+    // One device found by a scan. The address is the 12 hex digits the module
+    //  reports, packed into 6 bytes (formatAddress() turns it back into
+    //  text). rssi is in dBm; lastSeen is the millis() time of the most recent
+    //  report, and hits is the number of reports (up to 255).
+    struct scanEntry
+    {
+      byte address[6];
+      int8_t rssi;
+      byte hits;
+      unsigned long lastSeen;
+    };
+
+    // Which device to drop from a full scan table when a new one turns up.
+    enum scanPolicy {EVICT_WEAKEST, EVICT_OLDEST};
+
+    // Signature for the functions called when a device enters or leaves the
+    //  scan table.
+    typedef void (*scanCallback)(const scanEntry &entry);
+
+    // What connect() looks for when it isn't given an address: see
+    //  matchFilter().
+    struct connectFilter
+    {
+      byte address[6];
+      byte mask[6];
+      int8_t minRssi;
+      const char *namePrefix;
+    };
     
     BLEMate2(Stream* sp);
     opResult reset();  
@@ -32,31 +224,371 @@ class BLEMate2
     opResult writeConfig(); 
     opResult connect(byte index);
     opResult connect(String address);
+    opResult connect(const connectFilter &filter, unsigned long timeout);
+    unsigned long connectLatency();
     opResult connectionState();
+    unsigned long linkUptime();
+    unsigned long linkDowntime();
+    void     autoReconnect(String address);
+    void     autoReconnect();
+    void     setReconnectBackoff(unsigned long minDelay,
+                                 unsigned long maxDelay);
+    void     setReconnectJitter(byte percent);
+    unsigned int reconnectCount();
     opResult disconnect();
     opResult getAddress(byte index, String &address);
     byte     numAddresses();
-    opResult sendData(String &dataBuffer);
-    opResult sendData(char *dataBuffer, byte dataLen);
+    opResult getScanEntry(byte index, scanEntry &entry);
+    byte     strongest(scanEntry *list, byte n);
+    void     setScanPolicy(scanPolicy policy);
+    static void formatAddress(const byte *address, char *text);
+    opResult sendData(const String &dataBuffer);
+    opResult sendData(const char *dataBuffer, size_t dataLen);
     opResult sendData(const char *dataBuffer);
+    opResult sendData(Stream &source, size_t dataLen);
+    opResult sendData(dataSource source);
+    unsigned long sendRate();
+    unsigned int retransmitCount();
     opResult BLECentral();
     opResult BLEPeripheral();
     opResult amCentral(boolean &inCentralMode);
     opResult BLEAdvertise();
     opResult BLENoAdvertise();
     opResult BLEScan(unsigned int timeout);
-    opResult setBaudRate(unsigned int newSpeed);
+    opResult startScanning();
+    opResult stopScanning();
+    void     setScanAging(unsigned long maxAge);
+    void     onDeviceAppear(scanCallback callback);
+    void     onDeviceDisappear(scanCallback callback);
+    opResult setBaudRate(unsigned long newSpeed);
+    opResult autoBaud(baudSetter setter, unsigned long maxBaud = 460800);
+    unsigned long getBaudRate();
+    unsigned long baudThroughput();
     opResult addressQuery(String &address);
-    opResult stdGetParam(String command, String &param);
-    opResult stdSetParam(String command, String param);
-    opResult stdCmd(String command);
+    opResult firmwareVersion(String &version);
+    opResult stdGetParam(const char *command, String &param);
+    opResult stdGetParam(const __FlashStringHelper *command, String &param);
+    opResult stdGetParam(const String &command, String &param);
+    opResult stdSetParam(const char *command, const char *param);
+    opResult stdSetParam(const __FlashStringHelper *command,
+                         const __FlashStringHelper *param);
+    opResult stdSetParam(const String &command, const String &param);
+    opResult stdCmd(const char *command);
+    opResult stdCmd(const __FlashStringHelper *command);
+    opResult stdCmd(const String &command);
+    opResult refreshState();
+    opResult fastBegin(const BLEMate2Config &desired);
+    opResult readConfig(BLEMate2Config &config);
+    opResult applyConfig(const BLEMate2Config &desired,
+                         BLEMate2Config &current);
+    static unsigned int diffConfig(const BLEMate2Config &a,
+                                   const BLEMate2Config &b);
+    unsigned int resyncCount();
+    void     setDeadline(cmdType type, unsigned int deadline);
+    void     adaptDeadlines(boolean enable);
+    unsigned int learnedDeadline(cmdType type);
+#if BLE_MATE2_STATS
+    void     getStats(stats &out);
+    void     resetStats();
+    void     dumpStats(Print &out);
+#endif
+#if BLE_MATE2_TRACE_SIZE > 0
+    void     dumpTrace(Print &out);
+    void     clearTrace();
+#endif
+
+    // Data from the remote device. The module hands that to us on RCV= lines;
+    //  we strip those down to the data and keep it here until it's read, so
+    //  a BLEMate2 can be used like any other Stream. Writing to it is the
+    //  same as calling sendData(), which means that each write() call makes
+    //  its own trip to the module; write a buffer at a time if you can.
+    int      available();
+    int      read();
+    int      peek();
+    size_t   read(char *buffer, size_t len);
+    void     flush();
+    size_t   write(uint8_t c);
+    size_t   write(const uint8_t *buffer, size_t size);
+    using Print::write;
+    unsigned int rxOverflowCount();
+
+    // Non-blocking versions of the above. Each of these queues a command and
+    //  returns right away; call poll() from loop() to move it along, and
+    //  either check busy()/lastResult() or register a callback with
+    //  onComplete() to find out how it went. Anything passed by reference
+    //  (or by pointer) must stay in scope until the command is done. The
+    //  callbacks all run inside poll(), and the blocking versions can't do
+    //  their job from there; they return BUSY_ERROR instead.
+    void     poll();
+    boolean  busy();
+    opResult lastResult();
+    void     onComplete(opCallback callback);
+    void     onConnect(eventCallback callback);
+    void     onDisconnect(eventCallback callback);
+    void     onScanResult(addressCallback callback);
+    void     onData(dataCallback callback);
+    void     beginBatch();
+    void     endBatch();
+    opResult waitForIdle();
+    void     setPipelineDepth(byte depth);
+    opResult beginReset();
+    opResult beginRestore();
+    opResult beginWriteConfig();
+    opResult beginConnect(byte index);
+    opResult beginConnect(String address);
+    opResult beginConnect(const connectFilter &filter, unsigned long timeout);
+    opResult beginDisconnect();
+    opResult beginSendData(const char *dataBuffer, size_t dataLen);
+    opResult beginSendData(Stream &source, size_t dataLen);
+    opResult beginSendData(dataSource source);
+    opResult beginAmCentral(boolean &inCentralMode);
+    opResult beginScan(unsigned int timeout);
+    opResult beginStartScanning();
+    opResult beginStopScanning();
+    opResult beginAddressQuery(String &address);
+    opResult beginGetParam(const char *command, String &param);
+    opResult beginGetParam(const __FlashStringHelper *command, String &param);
+    opResult beginGetParam(const String &command, String &param);
+    opResult beginSetParam(const char *command, const char *param);
+    opResult beginSetParam(const __FlashStringHelper *command,
+                           const __FlashStringHelper *param);
+    opResult beginSetParam(const String &command, const String &param);
+    opResult beginStdCmd(const char *command);
+    opResult beginStdCmd(const __FlashStringHelper *command);
+    opResult beginStdCmd(const String &command);
+    opResult beginRefreshState();
   private:
+    // A group has to know when it's being called from inside one of its
+    //  modules' poll(); see BLEMate2Group::polling().
+    friend class BLEMate2Group;
+
+    // Every line the BC118 sends us ends in "\n\r"; these are the kinds of
+    //  line we care about telling apart, based on how they start.
+    enum lineType {LINE_NONE, LINE_OK, LINE_ERR, LINE_RCV, LINE_SCN, LINE_STS,
+                   LINE_RPD, LINE_DCN, LINE_OTHER};
+
+    // What we believe the module's role to be. See noteStatus().
+    enum roleState {ROLE_UNKNOWN, ROLE_PERIPHERAL, ROLE_CENTRAL};
+
+    // Where a command is in its life. Most commands only use PHASE_FIRST; the
+    //  ones that need a follow-up command move on. PHASE_WAIT is for waiting
+    //  on the module without anything outstanding.
+    enum cmdPhase {PHASE_FIRST, PHASE_SECOND, PHASE_WAIT};
+
+    // Where the data for a send comes from.
+    enum sendSource {SOURCE_BUFFER, SOURCE_STREAM, SOURCE_FUNCTION};
+
+    // One slot in the command queue. What "out" and "arg" hold depends on
+    //  the command: the String or boolean a result goes into, the data to
+    //  send (or where to get it) and its length, or the scan timeout.
+    struct cmdEntry
+    {
+      cmdType type;
+      cmdPhase phase;
+      byte batch;
+      byte seq;
+      boolean written;
+      boolean aborted;
+      sendSource source;
+      opResult result;
+      unsigned long start;
+      unsigned long timeout;
+      unsigned long arg;
+#if BLE_MATE2_STATS
+      unsigned long sentAt;
+#endif
+      union
+      {
+        String *string;
+        boolean *flag;
+        const char *data;
+        Stream *stream;
+        dataSource source;
+        const connectFilter *filter;
+        BLEMate2Config *config;
+      } out;
+      char text[BLE_MATE2_CMD_SIZE];
+    };
+
     BLEMate2();
-    int _baudRate;
-    String _addresses[5];
-    byte _numAddresses;
+    unsigned long _baudRate;
+    unsigned long _baudThroughput;
+    byte findBaud(baudSetter setter);
+    boolean probeBaud();
+    opResult moveBaud(baudSetter setter, byte i);
+    opResult switchBaud(baudSetter setter, byte i);
+    opResult checkBaud();
+    // Scan table. See recordScanResult().
+    scanEntry _scanTable[BLE_MATE2_SCAN_SIZE];
+    byte _scanIndex[BLE_MATE2_SCAN_SIZE];
+    byte _scanCount;
+    scanPolicy _scanPolicy;
+    unsigned long _scanMaxAge;
+    byte _ageCursor;
+    scanCallback _appearCallback;
+    scanCallback _disappearCallback;
+    unsigned long _connectStart;
+    unsigned long _connectLatency;
+
+    // What VER told us about the module, the first time we asked. Neither
+    //  changes, so there's no need to ask again. See addressQuery().
+    byte _moduleAddress[6];
+    char _firmware[12];
+    boolean _haveIdentity;
+    opResult beginIdentity(String *address);
+
+    // Link state and the reconnect supervisor. See SparkFunConnections.cpp.
+    boolean _linkUp;
+    unsigned long _linkSince;
+    unsigned long _upTotal;
+    unsigned long _downTotal;
+    byte _peer[6];
+    boolean _havePeer;
+    boolean _reconnect;
+    unsigned long _reconnectAt;
+    unsigned long _reconnectDelay;
+    unsigned long _reconnectMin;
+    unsigned long _reconnectMax;
+    byte _reconnectJitter;
+    byte _reconnectSeq;
+    unsigned int _reconnects;
+    void setLinkState(boolean up);
+    void superviseLink();
+    void reconnectResult(opResult result);
+    boolean matchFilter(const connectFilter *filter);
+    void ageScanTable();
+    void removeScanEntry(byte slot);
+    byte scanVictim(int8_t rssi);
+    boolean findAddress(const byte *address, byte &pos);
+    boolean parseAddress(const char *text, byte *address);
+    int8_t parseRssi();
     Stream *_serialPort;
-    opResult knownStart();
+    roleState _role;
+    void noteStatus();
+    boolean needSync();
+    boolean _synced;
+    unsigned int _resyncCount;
+
+    // Deadlines. _deadlines holds the user's overrides, by command type, 0
+    //  meaning none. The rest is what adaptDeadlines() has learned about the
+    //  commands that just get an OK or ERR back, kept the way TCP keeps its
+    //  round trip times: a smoothed latency (in eighths of a millisecond) and
+    //  a smoothed deviation (in quarters).
+    enum {ADAPT_STD, ADAPT_GET, ADAPT_STATUS, ADAPT_TYPES, ADAPT_NONE = 0xFF};
+    unsigned int _deadlines[CMD_TYPES];
+    boolean _adapt;
+    unsigned int _latency8[ADAPT_TYPES];
+    unsigned int _deviation4[ADAPT_TYPES];
+    byte _latencySamples[ADAPT_TYPES];
+    static byte adaptSlot(cmdType type);
+    static boolean slowCommand(cmdEntry *cmd);
+    unsigned long deadlineFor(cmdType type, unsigned long timeout,
+                              boolean adapt = true);
+    void learnLatency(cmdEntry *cmd, opResult result);
+
+    // Command engine state. See SparkFunCommandEngine.cpp for details.
+    cmdEntry _queue[BLE_MATE2_QUEUE_SIZE];
+    byte _qHead;
+    byte _qCount;
+    byte _qSent;
+    byte _pipelineDepth;
+    byte _batch;
+    boolean _inBatch;
+    byte _failedBatch;
+    byte _seq;
+    byte _waitSeq;
+    boolean _waitDone;
+    opResult _waitResult;
+    boolean _syncing;
+    byte _owed;
+    opResult _lastResult;
+    opResult _idleResult;
+    opCallback _callback;
+    eventCallback _connectCallback;
+    eventCallback _disconnectCallback;
+    addressCallback _scanCallback;
+    dataCallback _dataCallback;
+    boolean dispatchEvent(lineType line);
+    unsigned long _cmdDataPos;
+    unsigned long _cmdStart;
+    byte _cmdChunkLen;
+    byte _cmdRetries;
+    char _sendBuf[BLE_MATE2_SEND_CHUNK];
+    unsigned long _sendRate;
+    unsigned int _retransmits;
+
+    // Receive buffer. See receiveData().
+    char _rxBuf[BLE_MATE2_RX_SIZE];
+    unsigned int _rxHead;
+    unsigned int _rxCount;
+    unsigned int _rxOverflows;
+    boolean _polling;
+    void receiveData();
+    cmdEntry *newCommand(cmdType type, unsigned long timeout);
+    opResult queueCommand(cmdEntry *cmd);
+    opResult abandonBatch();
+    cmdEntry *queued(byte index);
+    boolean isExclusive(cmdEntry *cmd);
+    boolean owesAnswer(cmdEntry *cmd);
+    void sendQueued();
+    void sendCommand(cmdEntry *cmd);
+    void nextPhase(cmdEntry *cmd, cmdPhase phase, unsigned long timeout);
+    void commandLine(cmdEntry *cmd, lineType line);
+    const char *getAnswer(cmdEntry *cmd);
+    void checkTimeouts();
+    void commandTimeout(cmdEntry *cmd);
+    void finishCommand(opResult result);
+    void popCommand(opResult result);
+    void noteCommand(cmdEntry *cmd);
+    boolean nextChunk(cmdEntry *cmd);
+    void sendChunk(cmdEntry *cmd);
+    void finishSend(opResult result);
+    void recordScanResult();
+    void storeConfig(BLEMate2Config *config, byte field, const char *value);
+    void configText(const BLEMate2Config &config, byte field, char *text);
+    static unsigned long baudFromCode(const char *code);
+    void writeText(const char *text);
+    void writeText(const __FlashStringHelper *text);
+    void writeBytes(const uint8_t *data, size_t len);
+    int  readByte();
+#if BLE_MATE2_STATS
+    stats _stats;
+    void recordStats(cmdEntry *cmd, opResult result);
+    boolean strayLine(cmdEntry *cmd, lineType line);
+#endif
+#if BLE_MATE2_TRACE_SIZE > 0
+    byte _trace[BLE_MATE2_TRACE_SIZE & ~1];
+    unsigned int _traceHead;
+    unsigned int _traceCount;
+    unsigned long _traceLast;
+    void traceByte(boolean tx, byte c);
+    void traceEntry(byte tag, byte c);
+#endif
+    // Every command we build, by number. The text of each lives in flash,
+    //  in cmdTable (see SparkFunCommandEngine.cpp), with a '%' wherever an
+    //  argument goes. flashArgs tells buildCmd() which of the arguments are
+    //  in flash too.
+    enum cmdId {ID_TEXT, ID_SET, ID_GET, ID_VER, ID_RST, ID_STS, ID_SCNT,
+                ID_CON, ID_DCN};
+    enum {FLASH_ARG1 = 1, FLASH_ARG2 = 2};
+    boolean buildCmd(cmdEntry *cmd, cmdId id, const char *arg1 = NULL,
+                     const char *arg2 = NULL, byte flashArgs = 0);
+    opResult beginCmd(cmdType type, unsigned long timeout, String *out,
+                      cmdId id, const char *arg1, const char *arg2 = NULL,
+                      byte flashArgs = 0);
+    opResult blockUntilDone(opResult started);
+    opResult waitForRoom();
+
+    // Line assembler state. See readLine() for details.
+    char _lineBuf[BLE_MATE2_LINE_SIZE];
+    byte _lineLen;
+    boolean _lineReady;
+    boolean _lineOverflow;
+    unsigned long _lastRxTime;
+    lineType readLine();
+    lineType classifyLine();
+    boolean lineStartsWith(const char *prefix);
+    void clearLine();
 };
 
 
@@ -0,0 +1,1061 @@
+/****************************************************************
+Command engine for BC118 modules.
+
+Every command the library sends goes through here: it's queued,
+put on the wire, matched up with the lines the module sends back
+and finished off with a result.
+
+This code is beerware; if you use it, please buy me (or any other
+SparkFun employee) a cold beverage next time you run into one of
+us at the local.
+
+Code developed in Arduino 1.0.6, on an Arduino Pro 5V.
+****************************************************************/
+
+#include "SparkFunBLEMate2.h"
+#include <Arduino.h>
+
+// Every command used to sit in its own while() loop until it was done, which
+//  meant nothing else could happen for as much as several seconds. Now each
+//  command is a little state machine sitting in a queue: the begin*()
+//  functions set it up and queue it, and poll() feeds the command at the
+//  front of the queue whatever lines come back from the module until one of
+//  them (or a timeout) finishes it. The blocking functions are just a
+//  begin*() followed by calling poll() until the command is done.
+//
+// The BC118 answers commands in the order it gets them, so we don't have to
+//  wait for one answer before sending the next command; up to
+//  _pipelineDepth simple commands can be on the wire at once, and the
+//  responses are matched up with them in order. Commands that involve more
+//  than one exchange with the module (reset, scan, connect and so on) always
+//  go out on their own.
+//
+// poll() also looks after data coming in from the remote device, so it's
+//  worth calling from loop() even when there are no commands in the queue.
+void BLEMate2::poll()
+{
+  // poll() can end up calling itself (say, from a callback that checks
+  //  available()); the inner call would trample the line we're working on.
+  if (_polling) return;
+  _polling = true;
+
+  // Every line goes to the event dispatcher first, and then (unless it was
+  //  data) to the command at the front of the queue. Commands ignore lines
+  //  they don't recognize, so events arriving in the middle of a command
+  //  don't upset it.
+  lineType line;
+  while ((line = readLine()) != LINE_NONE)
+  {
+    if (dispatchEvent(line)) continue;
+
+    // While we're purging, the only thing that matters is the "ERR" our
+    //  bare "\r" provokes. Once we see it, we're in sync and can carry on.
+    //  The answers to commands we gave up on come first, though, and one of
+    //  those could be an ERR too; we know how many there are still to come,
+    //  so we let that many go by before we believe it.
+    if (_syncing)
+    {
+      if ((line == LINE_OK || line == LINE_ERR) && _owed > 0) _owed--;
+      else if (line == LINE_ERR)
+      {
+        _syncing = false;
+        _synced = true;
+        sendQueued();
+      }
+    }
+    else if (_qSent > 0)
+    {
+#if BLE_MATE2_STATS
+      if (strayLine(queued(0), line)) _stats.unsolicited++;
+#endif
+      commandLine(queued(0), line);
+    }
+    else if ((line == LINE_OK || line == LINE_ERR) && _owed > 0)
+    {
+      _owed--;
+    }
+#if BLE_MATE2_STATS
+    else if (line == LINE_OK || line == LINE_ERR || line == LINE_OTHER)
+    {
+      _stats.unsolicited++;
+    }
+#endif
+  }
+  ageScanTable();
+  superviseLink();
+
+  // We're still polling as far as everyone else is concerned until the
+  //  timeouts are dealt with, too: a timeout calls onComplete() like any
+  //  other result, and a blocking call from in there would trample the wait
+  //  that's in progress.
+  checkTimeouts();
+  _polling = false;
+}
+
+void BLEMate2::checkTimeouts()
+{
+  if (_qCount == 0) return;
+
+  // The sync uses the time since the last character came in, so a stream of
+  //  junk from the module doesn't time us out while we purge it. If the
+  //  module never answers, we'll go ahead and send the command anyway; it may
+  //  well work out. It goes out on its own, though: we're still not in step
+  //  until it gets an OK back (see finishCommand()), and anything pipelined
+  //  behind it would be written off as aborted when it did.
+  if (_syncing)
+  {
+    if (millis() - _lastRxTime >= 1000)
+    {
+      _syncing = false;
+      _owed = 0;
+      sendCommand(queued(0));
+      _qSent = 1;
+    }
+  }
+  // Everything else is timed from when the command went out, or from when
+  //  it got to the front of the queue, whichever came later.
+  else if (_qSent > 0)
+  {
+    cmdEntry *cmd = queued(0);
+    if (millis() - cmd->start >= cmd->timeout)
+    {
+      commandTimeout(cmd);
+    }
+  }
+}
+
+boolean BLEMate2::busy()
+{
+  return _qCount != 0;
+}
+
+BLEMate2::opResult BLEMate2::lastResult()
+{
+  return _lastResult;
+}
+
+void BLEMate2::onComplete(opCallback callback)
+{
+  _callback = callback;
+}
+
+// The module tells us about some things whether we asked or not: remote
+//  devices connecting and disconnecting, devices found while scanning, and
+//  data arriving. These let the user hear about them as they happen. Like
+//  onComplete(), the functions get called from inside poll().
+void BLEMate2::onConnect(eventCallback callback)
+{
+  _connectCallback = callback;
+}
+
+void BLEMate2::onDisconnect(eventCallback callback)
+{
+  _disconnectCallback = callback;
+}
+
+void BLEMate2::onScanResult(addressCallback callback)
+{
+  _scanCallback = callback;
+}
+
+// If there's an onData() function, received data goes to it instead of into
+//  the receive buffer.
+void BLEMate2::onData(dataCallback callback)
+{
+  _dataCallback = callback;
+}
+
+// Have a look at a line from the module before any command sees it, and pass
+//  along anything the user (or the library) wants to know about no matter
+//  what command, if any, is running. Returns true if the line has been dealt
+//  with and no command should see it.
+boolean BLEMate2::dispatchEvent(lineType line)
+{
+  switch (line)
+  {
+    // Data from the remote device is never the answer to a command.
+    case LINE_RCV:
+      receiveData();
+      return true;
+
+    // Status lines keep our idea of the module's role up to date, no matter
+    //  who asked for them.
+    case LINE_STS:
+      noteStatus();
+      break;
+
+    // SCN=? 12charaddrxx bunch of other stuff. Whenever the module is
+    //  scanning, for whatever reason, what it finds goes into the scan table.
+    //  We hand the user just the address, but we have to put the line back
+    //  the way it was for the scan command.
+    case LINE_SCN:
+      recordScanResult();
+      if (_scanCallback != NULL && _lineLen >= 18)
+      {
+        char c = _lineBuf[18];
+        _lineBuf[18] = '\0';
+        _scanCallback(&_lineBuf[6]);
+        _lineBuf[18] = c;
+      }
+      break;
+
+    case LINE_RPD:
+      setLinkState(true);
+      if (_connectCallback != NULL) _connectCallback();
+      break;
+
+    case LINE_DCN:
+      setLinkState(false);
+      if (_disconnectCallback != NULL) _disconnectCallback();
+      break;
+
+    default:
+      break;
+  }
+  return false;
+}
+
+// Commands queued between beginBatch() and endBatch() stand or fall
+//  together: if one of them fails, the ones behind it are dropped (reported
+//  as ABORTED_ERROR) rather than sent to a module that's in a state we
+//  didn't plan for. That goes for the ones queued after the failure, too,
+//  and waitForIdle() reports the failure even if the queue ran dry in the
+//  middle of the batch. Commands that were already on the wire when the
+//  failure came back get their own answers.
+void BLEMate2::beginBatch()
+{
+  // Whichever batch failed last, it wasn't this one.
+  _failedBatch = _batch++;
+  _inBatch = true;
+  if (_qCount == 0) _idleResult = SUCCESS;
+}
+
+void BLEMate2::endBatch()
+{
+  _inBatch = false;
+}
+
+// For when there's no room to queue the rest of a batch. Whatever part of it
+//  is queued but not yet on the wire gets dropped, just as if one of its
+//  members had failed, and the batch is closed. The BUSY_ERROR is for the
+//  caller to pass along.
+BLEMate2::opResult BLEMate2::abandonBatch()
+{
+  _failedBatch = _batch;
+  for (byte i = 0; i < _qCount; i++)
+  {
+    if (queued(i)->batch == _batch && !queued(i)->written)
+    {
+      queued(i)->aborted = true;
+    }
+  }
+  endBatch();
+  return BUSY_ERROR;
+}
+
+// Block until every queued command has finished. The result is SUCCESS if
+//  they all went through, or else the first failure along the way. From
+//  inside poll(), the queue can't move, so that's a BUSY_ERROR.
+BLEMate2::opResult BLEMate2::waitForIdle()
+{
+  if (_polling && busy()) return BUSY_ERROR;
+  while (busy())
+  {
+    poll();
+  }
+  return _idleResult;
+}
+
+// How many commands we'll put on the wire before waiting for answers. One
+//  gets you the old send-and-wait behavior.
+void BLEMate2::setPipelineDepth(byte depth)
+{
+  if (depth < 1) depth = 1;
+  if (depth > BLE_MATE2_QUEUE_SIZE) depth = BLE_MATE2_QUEUE_SIZE;
+  _pipelineDepth = depth;
+}
+
+// Find the next free slot in the queue and set it up for a command. It
+//  doesn't become part of the queue until queueCommand() is called, so the
+//  caller can bail out without cleaning up. Returns NULL if the queue is full.
+BLEMate2::cmdEntry *BLEMate2::newCommand(cmdType type, unsigned long timeout)
+{
+  // If the module's been talking while we weren't listening, hear it out
+  //  first. Otherwise, needSync() will take the waiting input as a sign
+  //  we're out of step with the module, when it's most likely just events.
+  //  This has to happen before we pick a slot: a callback or the reconnect
+  //  supervisor can queue commands of their own from inside poll().
+  if (_qSent == 0 && !_polling) poll();
+
+  if (_qCount >= BLE_MATE2_QUEUE_SIZE) return NULL;
+
+  cmdEntry *cmd = &_queue[(_qHead + _qCount) % BLE_MATE2_QUEUE_SIZE];
+  cmd->type = type;
+  cmd->phase = PHASE_FIRST;
+  cmd->written = false;
+  cmd->aborted = false;
+  cmd->result = DEFAULT_ERR;
+  cmd->timeout = timeout;
+  cmd->arg = 0;
+  cmd->text[0] = '\0';
+  return cmd;
+}
+
+// Add a command set up by newCommand() to the queue, and send it right away
+//  if there's room on the wire for it.
+BLEMate2::opResult BLEMate2::queueCommand(cmdEntry *cmd)
+{
+  // The deadline waits until now, when we know what the command says; see
+  //  slowCommand() for why that matters.
+  cmd->timeout = deadlineFor(cmd->type, cmd->timeout, !slowCommand(cmd));
+  if (_qCount == 0 && !_inBatch) _idleResult = SUCCESS;
+  if (!_inBatch) _batch++;
+  cmd->batch = _batch;
+  if (_inBatch && _batch == _failedBatch) cmd->aborted = true;
+  if (++_seq == 0) _seq = 1; // 0 never names a command.
+  cmd->seq = _seq;
+  _qCount++;
+  _lastResult = IN_PROGRESS;
+  sendQueued();
+  return SUCCESS;
+}
+
+// Commands are numbered from the front of the queue.
+BLEMate2::cmdEntry *BLEMate2::queued(byte index)
+{
+  return &_queue[(_qHead + index) % BLE_MATE2_QUEUE_SIZE];
+}
+
+// Commands that take more than one exchange with the module, or that don't
+//  end in a tidy OK/ERR, can't share the wire with anything else.
+boolean BLEMate2::isExclusive(cmdEntry *cmd)
+{
+  return !(cmd->type == CMD_STD || cmd->type == CMD_GET ||
+           cmd->type == CMD_STATUS || cmd->type == CMD_CONFIG);
+}
+
+// Does the module still owe us an OK or ERR for this command? Those are the
+//  ones that count against a resync (see poll()). If it never heard the
+//  command at all, we'll wait for an answer that isn't coming; the resync
+//  gives up on that after a quiet second, same as it always has.
+boolean BLEMate2::owesAnswer(cmdEntry *cmd)
+{
+  return cmd->written && (!isExclusive(cmd) || cmd->type == CMD_SEND);
+}
+
+// Put as many queued commands on the wire as we're allowed to.
+void BLEMate2::sendQueued()
+{
+  while (_qCount > 0)
+  {
+    // Commands from a failed batch that never made it out are done as soon
+    //  as they get to the front of the queue.
+    if (_qSent == 0 && queued(0)->aborted)
+    {
+      popCommand(ABORTED_ERROR);
+      continue;
+    }
+    if (_syncing || _qSent >= _qCount || _qSent >= _pipelineDepth) return;
+    if (_qSent > 0 && !_synced) return;
+
+    cmdEntry *cmd = queued(_qSent);
+    if (cmd->aborted) return;
+    if (_qSent > 0 && (isExclusive(cmd) || isExclusive(queued(0)))) return;
+
+    // If we don't trust our sync with the module, send a bare "\r" first. If
+    //  a partial command is already in the module's buffer, that purges it;
+    //  if not, we just get an error back, which is exactly what poll() waits
+    //  for.
+    if (_qSent == 0 && needSync())
+    {
+      _resyncCount++;
+#if BLE_MATE2_STATS
+      _stats.resyncs++;
+#endif
+      _syncing = true;
+      _lastRxTime = millis();
+      writeText("\r");
+      _serialPort->flush();
+      return;
+    }
+
+    sendCommand(cmd);
+    _qSent++;
+  }
+}
+
+// Put whatever the current phase of a command calls for out on the wire, and
+//  start the clock on the response.
+void BLEMate2::sendCommand(cmdEntry *cmd)
+{
+  if (cmd->type == CMD_SEND)
+  {
+    sendChunk(cmd);
+  }
+  else if (cmd->type == CMD_CONNECT)
+  {
+    // The module has to be in SCAN mode for the CON command to work, so we
+    //  start a scan first and only send CON once the module OKs that. While
+    //  we're watching for a device that fits a connect filter, there's
+    //  nothing to send.
+    if (cmd->phase == PHASE_FIRST)
+    {
+      _connectStart = millis();
+      writeText(F("SCN ON\r"));
+    }
+    else if (cmd->phase == PHASE_SECOND)
+    {
+      writeText(cmd->text);
+      writeText("\r");
+    }
+  }
+  else if (cmd->phase == PHASE_SECOND)
+  {
+    // A timed scan reports on what it found, so it starts from an empty
+    //  table; what's there now is gone as far as the scan's concerned, and
+    //  onDeviceDisappear() hears about each one. An ongoing scan just keeps
+    //  the table up to date.
+    if (cmd->type == CMD_SCAN && cmd->arg != 0)
+    {
+      while (_scanCount > 0) removeScanEntry(_scanCount - 1);
+    }
+
+    // The follow-up commands are all fixed strings.
+    if (cmd->type == CMD_SCAN) writeText(F("SCN ON\r"));
+    else writeText(F("SCN OFF\r"));
+  }
+  else
+  {
+    writeText(cmd->text);
+    writeText("\r");
+  }
+  // Waiting for the command to go out means its clock starts when the module
+  //  has it. A chunk of data takes long enough to go out that the wait
+  //  matters, though: with more than one module, the others could be busy
+  //  all that time. Its three seconds are plenty to cover the trip, so it
+  //  doesn't wait.
+  if (cmd->type != CMD_SEND) _serialPort->flush();
+#if BLE_MATE2_STATS
+  if (!cmd->written) cmd->sentAt = millis();
+#endif
+  cmd->written = true;
+  cmd->start = millis();
+}
+
+// Move an exclusive command on to its next phase.
+void BLEMate2::nextPhase(cmdEntry *cmd, cmdPhase phase, unsigned long timeout)
+{
+  cmd->phase = phase;
+  cmd->timeout = timeout;
+  sendCommand(cmd);
+}
+
+// This is where the lines coming back from the module get matched up with the
+//  command that's waiting for them.
+void BLEMate2::commandLine(cmdEntry *cmd, lineType line)
+{
+  switch (cmd->type)
+  {
+    case CMD_STD:
+      if (line == LINE_ERR) finishCommand(MODULE_ERROR);
+      else if (line == LINE_OK)
+      {
+        noteCommand(cmd);
+        finishCommand(SUCCESS);
+      }
+      break;
+
+    case CMD_GET:
+    case CMD_CONFIG:
+      // ERR and OK are simple enough- success or failure.
+      if (line == LINE_ERR) finishCommand(MODULE_ERROR);
+      else if (line == LINE_OK) finishCommand(SUCCESS);
+      // BUT if the line starts with the parameter name, we'll want to
+      //  extract the value returned by the module; see getAnswer().
+      else if (line == LINE_OTHER && getAnswer(cmd) != NULL)
+      {
+        // readLine() has already stripped the EOL, but we'll trim any stray
+        //  whitespace too. A CMD_CONFIG is a GET that goes into one field of
+        //  a BLEMate2Config; arg says which.
+        const char *value = getAnswer(cmd);
+        if (cmd->type == CMD_CONFIG)
+        {
+          storeConfig(cmd->out.config, cmd->arg, value);
+        }
+        else
+        {
+          *cmd->out.string = value;
+          cmd->out.string->trim();
+        }
+      }
+      break;
+
+    case CMD_STATUS:
+      if (line == LINE_ERR) finishCommand(MODULE_ERROR);
+      else if (line == LINE_OK) finishCommand(SUCCESS);
+      else if (line == LINE_STS && cmd->out.flag != NULL)
+      {
+        *cmd->out.flag = (_role == ROLE_CENTRAL);
+      }
+      break;
+
+    case CMD_VERSION:
+      // There are several possibilities for return values:
+      //  1. ERR - indicates a problem with the module. Either we're in the
+      //           wrong state to be trying to do this (we're not central,
+      //           not idle, or both) or there's a syntax error.
+      //  2. Bluetooth Address xxxxxxxxxxxx - this is the one we want to
+      //           match. HOWEVER, there are *other* input strings after
+      //           issuing the VER command.
+      //  3. BlueCreation Copyright 2012-2014
+      //  4. www.bluecreation.com
+      //  5. Melody Smart vxxxxxxx
+      //  6. Build: xxxxxxxxx
+      //  7. OK
+      // The important string is number 2, and of course it comes last. We
+      //  keep number 5 as well, for firmwareVersion(). In practice, the OK
+      //  never comes, and waiting for it used to mean every VER ran out the
+      //  clock. Now, once we have the address, we only wait long enough to
+      //  be sure an OK isn't right behind it (if one were, and we'd already
+      //  moved on, it would be taken for the answer to the next command).
+      if (line == LINE_ERR) finishCommand(MODULE_ERROR);
+      else if (line == LINE_OK) finishCommand(cmd->result);
+      else if (lineStartsWith(PSTR("Melody Smart v")))
+      {
+        strncpy(_firmware, &_lineBuf[14], sizeof(_firmware) - 1);
+        _firmware[sizeof(_firmware) - 1] = '\0';
+      }
+      else if (lineStartsWith(PSTR("Bluet")) && _lineLen >= 30)
+      {
+        // The returned device string looks like this:
+        //  Bluetooth Address xxxxxxxxxxxx
+        // We can ignore the other stuff, and the first stuff, and just
+        //  report the address.
+        _lineBuf[30] = '\0';
+        if (cmd->out.string != NULL) *cmd->out.string = &_lineBuf[18];
+        _haveIdentity = parseAddress(&_lineBuf[18], _moduleAddress);
+        cmd->result = SUCCESS;
+        cmd->phase = PHASE_WAIT;
+        cmd->start = millis();
+        cmd->timeout = 20;
+      }
+      break;
+
+    case CMD_RESET:
+      // If ERR or READY, we've finished the reset. Otherwise, just discard
+      //  the line and wait for the next one.
+      if (cmd->phase == PHASE_FIRST)
+      {
+        if (line == LINE_ERR) finishCommand(MODULE_ERROR);
+        else if (line == LINE_OTHER && lineStartsWith(PSTR("READY")))
+        {
+          _synced = true; // Fresh out of reset, the module's buffer is empty.
+          _owed = 0;      // And it's forgotten anything it hadn't answered.
+          _role = ROLE_UNKNOWN; // And it's back to whatever's in NVM.
+          setLinkState(false);  // Any connection we had is gone, too.
+          nextPhase(cmd, PHASE_SECOND, deadlineFor(cmd->type, 3000));
+        }
+      }
+      // Whatever the module says about "SCN OFF", we're done. Any scan
+      //  results still on their way are events like any others, so there's
+      //  no need to wait for them to die down.
+      else if (line == LINE_OK || line == LINE_ERR)
+      {
+        finishCommand(SUCCESS);
+      }
+      break;
+
+    case CMD_SCAN:
+      // The SCNT setting comes first. We don't much care how that goes; the
+      //  scan itself is what we report on.
+      if (cmd->phase == PHASE_FIRST)
+      {
+        if (line == LINE_OK || line == LINE_ERR)
+        {
+          nextPhase(cmd, PHASE_SECOND, cmd->arg ? cmd->arg : cmd->timeout);
+        }
+      }
+      // A continuous scan (see startScanning()) is done as soon as the
+      //  module says the scan is on; the results come in as events.
+      else if (cmd->arg == 0)
+      {
+        if (line == LINE_OK) finishCommand(SUCCESS);
+        else if (line == LINE_ERR) finishCommand(MODULE_ERROR);
+      }
+      // There are two possibilities for return values:
+      //  1. ERR - indicates a problem with the module. Either we're in the
+      //           wrong state to be trying to do this (we're not central,
+      //           not idle, or both) or there's a syntax error.
+      //  2. SCN=X 12charaddrxx name -rssi xxxxxxxxxxxxxxx\n\r
+      //           recordScanResult() picks that apart for the scan table.
+      // Note the lack of any kind of completion string! The module just stops
+      //  reporting when done, and we'll never know if it doesn't find anything
+      //  to report. We used to stop at five devices, but the table can hold
+      //  more than that (and choose between them), so we let the scan run.
+      else if (line == LINE_ERR) finishCommand(MODULE_ERROR);
+      else if (line == LINE_SCN && _scanCount > 0) cmd->result = SUCCESS;
+      break;
+
+    case CMD_CONNECT:
+      // First the scan has to start. Then either we know who we want (and
+      //  the CON is already built), or we watch the scan reports for the
+      //  first device that fits the filter and build it then.
+      if (cmd->phase == PHASE_FIRST)
+      {
+        if (line == LINE_ERR) finishCommand(MODULE_ERROR);
+        else if (line == LINE_OK)
+        {
+          if (cmd->text[0] != '\0')
+          {
+            nextPhase(cmd, PHASE_SECOND, deadlineFor(cmd->type, 5000));
+          }
+          else nextPhase(cmd, PHASE_WAIT, cmd->arg);
+        }
+      }
+      else if (cmd->phase == PHASE_WAIT)
+      {
+        if (line == LINE_SCN && matchFilter(cmd->out.filter))
+        {
+          char address[13];
+          memcpy(address, &_lineBuf[6], 12);
+          address[12] = '\0';
+          buildCmd(cmd, ID_CON, address);
+          nextPhase(cmd, PHASE_SECOND, deadlineFor(cmd->type, 5000));
+        }
+      }
+      else if (line == LINE_ERR) finishCommand(MODULE_ERROR);
+      else if (line == LINE_RPD)
+      {
+        // Remember who it was, for the reconnect supervisor.
+        _havePeer = parseAddress(&cmd->text[4], _peer);
+        _connectLatency = millis() - _connectStart;
+        finishCommand(SUCCESS);
+      }
+      break;
+
+    case CMD_DISCONNECT:
+      if (cmd->phase == PHASE_FIRST)
+      {
+        if (line == LINE_ERR) finishCommand(MODULE_ERROR);
+        else if (line == LINE_DCN)
+        {
+          nextPhase(cmd, PHASE_SECOND, deadlineFor(cmd->type, 3000));
+        }
+      }
+      else if (line == LINE_OK || line == LINE_ERR) finishCommand(SUCCESS);
+      break;
+
+    case CMD_SEND:
+      // If we didn't know whether the module is central or not, we asked
+      //  with STS first (poll() takes note of the answer). After that, each
+      //  chunk gets an OK, and then we move on to the next one. An ERR gets
+      //  the same chunk again, a couple of times, before we give up.
+      if (cmd->phase == PHASE_FIRST)
+      {
+        if (line == LINE_ERR) finishSend(MODULE_ERROR);
+        else if (line == LINE_OK)
+        {
+          if (nextChunk(cmd)) nextPhase(cmd, PHASE_SECOND, cmd->timeout);
+          else finishSend(SUCCESS);
+        }
+      }
+      else if (line == LINE_ERR)
+      {
+        if (_cmdRetries++ < BLE_MATE2_SEND_RETRIES)
+        {
+          _retransmits++;
+          nextPhase(cmd, PHASE_SECOND, cmd->timeout);
+        }
+        else finishSend(MODULE_ERROR);
+      }
+      else if (line == LINE_OK)
+      {
+        _cmdDataPos += _cmdChunkLen;
+        if (nextChunk(cmd)) nextPhase(cmd, PHASE_SECOND, cmd->timeout);
+        else finishSend(SUCCESS);
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+// The module didn't come through in time. What that means depends on the
+//  command.
+void BLEMate2::commandTimeout(cmdEntry *cmd)
+{
+  // The follow-up commands were never checked in the old blocking code,
+  //  and there's no reason to fail the whole operation over them now.
+  if (cmd->phase == PHASE_SECOND &&
+      (cmd->type == CMD_RESET || cmd->type == CMD_DISCONNECT))
+  {
+    finishCommand(SUCCESS);
+    return;
+  }
+
+  // VER has given us everything it's going to.
+  if (cmd->phase == PHASE_WAIT && cmd->type == CMD_VERSION)
+  {
+    finishCommand(cmd->result);
+    return;
+  }
+
+  // Nothing that fit the connect filter turned up. That's not the module's
+  //  fault; it answered everything we asked.
+  if (cmd->phase == PHASE_WAIT)
+  {
+    finishCommand(REMOTE_ERROR);
+    return;
+  }
+
+  switch (cmd->type)
+  {
+    // A scan has no completion string; the module just stops reporting. So
+    //  running out the clock is the normal way for it to end, and the result
+    //  depends on whether we saw anything. (VER used to be here too, but it
+    //  finishes off the address line now; a VER that gets here is a module
+    //  that didn't answer, same as anything else.)
+    case CMD_SCAN:
+      if (cmd->phase == PHASE_FIRST)
+      {
+        nextPhase(cmd, PHASE_SECOND, cmd->arg ? cmd->arg : cmd->timeout);
+        return;
+      }
+      if (cmd->arg != 0)
+      {
+        finishCommand(cmd->result);
+        return;
+      }
+      // A continuous scan, on the other hand, should have had an OK.
+      _synced = false;
+      finishCommand(TIMEOUT_ERROR);
+      return;
+
+    // Whatever we were waiting for, we lost track of it. Resync next time.
+    default:
+      _synced = false;
+      finishCommand(TIMEOUT_ERROR);
+      return;
+  }
+}
+
+// The value in the line we just read, if it's the answer to a GET. As an
+//  example, "GET ADDR" will cause the module to return with
+//  "ADDR=value\n\rOK\n\r". The name is whatever follows "GET " in the
+//  command we sent. That's in RAM, so it's strncmp() here, not
+//  lineStartsWith().
+const char *BLEMate2::getAnswer(cmdEntry *cmd)
+{
+  const char *name = &cmd->text[4];
+  size_t len = strlen(name);
+  if (strncmp(_lineBuf, name, len) != 0 || _lineBuf[len] != '=') return NULL;
+  return &_lineBuf[len + 1];
+}
+
+// Wrap up the command at the front of the queue, then get the next ones
+//  moving.
+void BLEMate2::finishCommand(opResult result)
+{
+  byte batch = queued(0)->batch;
+
+  // The only way a command gets answered while we're out of step is the
+  //  resync giving up on its ERR and sending the command anyway. An OK is
+  //  the module answering a command, not the bare "\r", so we take that as
+  //  being back in step. An ERR could be the one the resync was waiting
+  //  for, so that doesn't count; the next command resyncs again.
+  if (!_synced && result == SUCCESS) _synced = true;
+
+  // If we've lost sync with the module, the answers to anything else we had
+  //  on the wire can't be trusted. They'll still turn up, though (as will
+  //  the answer to a command that timed out), so we keep count of them for
+  //  the resync to skip over.
+  if (!_synced && result == TIMEOUT_ERROR && owesAnswer(queued(0))) _owed++;
+  popCommand(result);
+  if (!_synced)
+  {
+    while (_qSent > 0)
+    {
+      if (owesAnswer(queued(0))) _owed++;
+      popCommand(ABORTED_ERROR);
+    }
+  }
+
+  // A failure takes the rest of its batch down with it: what's still in the
+  //  queue now, and whatever gets queued later.
+  if (result == MODULE_ERROR || result == TIMEOUT_ERROR)
+  {
+    _failedBatch = batch;
+    for (byte i = 0; i < _qCount; i++)
+    {
+      if (queued(i)->batch == batch && !queued(i)->written)
+      {
+        queued(i)->aborted = true;
+      }
+    }
+  }
+
+  // The next command's answer has been waiting behind this one's, so its
+  //  clock starts now.
+  if (_qSent > 0) queued(0)->start = millis();
+  sendQueued();
+}
+
+// Take the command at the front off the queue and let the user know how it
+//  went. The slot may be reused by the callback, so we're done with it
+//  before we make the call.
+void BLEMate2::popCommand(opResult result)
+{
+  cmdEntry *cmd = queued(0);
+  if (cmd->aborted) result = ABORTED_ERROR;
+#if BLE_MATE2_STATS
+  recordStats(cmd, result);
+#endif
+  learnLatency(cmd, result);
+  byte seq = cmd->seq;
+  if (cmd->written) _qSent--;
+  _qHead = (_qHead + 1) % BLE_MATE2_QUEUE_SIZE;
+  _qCount--;
+
+  _lastResult = result;
+  if (result != SUCCESS && _idleResult == SUCCESS) _idleResult = result;
+  if (seq == _reconnectSeq)
+  {
+    _reconnectSeq = 0;
+    reconnectResult(result);
+  }
+  if (seq == _waitSeq)
+  {
+    _waitDone = true;
+    _waitResult = result;
+  }
+  if (_callback != NULL) _callback(result);
+}
+
+// The blocking functions all boil down to this: if the command got queued,
+//  keep the engine turning until it's done. That can't work from inside
+//  poll() (from an onComplete() or onConnect() callback, say), since poll()
+//  won't call itself and nothing would ever finish; there, the blocking
+//  functions return BUSY_ERROR. waitForRoom() turns them away before they
+//  queue anything, so this is only a backstop.
+BLEMate2::opResult BLEMate2::blockUntilDone(opResult started)
+{
+  if (started != SUCCESS) return started;
+  if (_polling) return BUSY_ERROR;
+  _waitSeq = _seq;
+  _waitDone = false;
+  while (!_waitDone)
+  {
+    poll();
+  }
+  return _waitResult;
+}
+
+// Blocking functions wait their turn rather than fail when the queue's full.
+//  From inside poll(), they can't wait for anything; see blockUntilDone().
+BLEMate2::opResult BLEMate2::waitForRoom()
+{
+  if (_polling) return BUSY_ERROR;
+  while (_qCount >= BLE_MATE2_QUEUE_SIZE)
+  {
+    poll();
+  }
+  return SUCCESS;
+}
+
+// The text of every command we build, indexed by cmdId. A '%' is where an
+//  argument goes. These live in flash, so they don't cost us any RAM; on an
+//  ATmega328, every string literal in the code otherwise gets a copy in RAM
+//  at startup, whether it's ever used or not.
+static const char cmdTable[][11] PROGMEM =
+{
+  "%",          // ID_TEXT
+  "SET %=%",    // ID_SET
+  "GET %",      // ID_GET
+  "VER",        // ID_VER
+  "RST",        // ID_RST
+  "STS",        // ID_STS
+  "SET SCNT=%", // ID_SCNT
+  "CON % 0",    // ID_CON
+  "DCN",        // ID_DCN
+};
+
+// Fill in a command's buffer from the table, copying the arguments in as we
+//  go. The arguments can be in RAM or (if their bit is set in flashArgs) in
+//  flash. Returns false if the result won't fit.
+boolean BLEMate2::buildCmd(cmdEntry *cmd, cmdId id, const char *arg1,
+                           const char *arg2, byte flashArgs)
+{
+  const char *format = cmdTable[id];
+  byte len = 0;
+  byte argNum = 0;
+  char c;
+  while ((c = pgm_read_byte(format++)) != '\0')
+  {
+    if (c != '%')
+    {
+      if (len >= BLE_MATE2_CMD_SIZE - 1) return false;
+      cmd->text[len++] = c;
+      continue;
+    }
+    const char *arg = (argNum == 0) ? arg1 : arg2;
+    boolean inFlash = flashArgs & (1 << argNum);
+    argNum++;
+    if (arg == NULL) continue;
+    while ((c = inFlash ? pgm_read_byte(arg) : *arg) != '\0')
+    {
+      if (len >= BLE_MATE2_CMD_SIZE - 1) return false;
+      cmd->text[len++] = c;
+      arg++;
+    }
+  }
+  cmd->text[len] = '\0';
+  return true;
+}
+
+// Most commands are nothing more than a line of text and an OK or ERR back;
+//  this takes care of queueing one of those. out is where a GET puts its
+//  answer.
+BLEMate2::opResult BLEMate2::beginCmd(cmdType type, unsigned long timeout,
+                                      String *out, cmdId id, const char *arg1,
+                                      const char *arg2, byte flashArgs)
+{
+  cmdEntry *cmd = newCommand(type, timeout);
+  if (cmd == NULL) return BUSY_ERROR;
+  if (!buildCmd(cmd, id, arg1, arg2, flashArgs)) return INVALID_PARAM;
+  cmd->out.string = out;
+  return queueCommand(cmd);
+}
+
+// We used to purge the module's buffer before every single command, which
+//  cost a full round trip to the module (and up to a second) each time.
+//  Instead, we track whether we're in step with the module and only
+//  resynchronize when we have reason to think we aren't: a command timed out
+//  or a line was too long to parse. Input nobody asked for used to count too,
+//  but now that poll() sorts out events, that's just the module being
+//  chatty (a scan in progress, say), and a half-read line of it is no reason
+//  to doubt what the module has heard from us.
+boolean BLEMate2::needSync()
+{
+  return !_synced;
+}
+
+// Every command gets a deadline: how long we give the module to answer before
+//  we call it a timeout. Each place a command is set up picks a number that's
+//  safe for the slowest module on its worst day, which is seconds, when most
+//  answers take a few milliseconds. There are two ways to do better.
+//  setDeadline() sets the deadline for every command of a type, replacing
+//  whatever the library would have picked (0 puts that back). The deadlines
+//  that come from what you ask for, like a scan's length or a connect
+//  filter's timeout, aren't affected.
+void BLEMate2::setDeadline(cmdType type, unsigned int deadline)
+{
+  if (type < CMD_TYPES) _deadlines[type] = deadline;
+}
+
+// Or, let the library work it out. With this on, we keep track of how long
+//  plain OK/ERR commands, GETs and status requests actually take, and once
+//  we've seen a few, give them a deadline of a little over the worst we'd
+//  expect: the smoothed latency plus four times its smoothed deviation (or
+//  twice the latency, if that's longer), but never less than
+//  BLE_MATE2_DEADLINE_FLOOR or more than the usual deadline. A timeout
+//  doubles the latency estimate for that kind of command, so if the module
+//  slows down for real, the deadline backs off to match. WRT, RTR, RST and
+//  VER are left out of it; see slowCommand().
+void BLEMate2::adaptDeadlines(boolean enable)
+{
+  _adapt = enable;
+}
+
+// The deadline adaptDeadlines() has worked out for a type of command, or 0 if
+//  it hasn't seen enough of them yet (or doesn't adapt that type at all).
+unsigned int BLEMate2::learnedDeadline(cmdType type)
+{
+  byte slot = adaptSlot(type);
+  if (slot == ADAPT_NONE || _latencySamples[slot] < 8) return 0;
+  unsigned int latency = _latency8[slot] >> 3;
+  unsigned int deadline = latency + _deviation4[slot];
+  if (deadline < latency * 2) deadline = latency * 2;
+  if (deadline < BLE_MATE2_DEADLINE_FLOOR) deadline = BLE_MATE2_DEADLINE_FLOOR;
+  return deadline;
+}
+
+// A GET into a BLEMate2Config is a GET like any other, as far as the module
+//  is concerned.
+byte BLEMate2::adaptSlot(cmdType type)
+{
+  switch (type)
+  {
+    case CMD_STD:    return ADAPT_STD;
+    case CMD_GET:
+    case CMD_CONFIG: return ADAPT_GET;
+    case CMD_STATUS: return ADAPT_STATUS;
+    default:         return ADAPT_NONE;
+  }
+}
+
+// A few of the commands that come back with a plain OK take the module a lot
+//  longer than the rest: WRT and RTR write NVM, and RST and VER, sent through
+//  stdCmd(), get a whole banner back first. A deadline learned from a run of
+//  quick SETs would time them out, and one of them would stretch the deadline
+//  for the SETs after it, so they're kept out of the learning altogether and
+//  always get the usual deadline.
+static const char slowCommands[][4] PROGMEM = {"WRT", "RTR", "RST", "VER"};
+
+boolean BLEMate2::slowCommand(cmdEntry *cmd)
+{
+  if (cmd->type != CMD_STD) return false;
+  for (byte i = 0; i < sizeof(slowCommands) / sizeof(slowCommands[0]); i++)
+  {
+    if (strcmp_P(cmd->text, slowCommands[i]) == 0) return true;
+  }
+  return false;
+}
+
+unsigned long BLEMate2::deadlineFor(cmdType type, unsigned long timeout,
+                                    boolean adapt)
+{
+  if (_deadlines[type] != 0) return _deadlines[type];
+  if (!_adapt || !adapt) return timeout;
+  unsigned int learned = learnedDeadline(type);
+  if (learned != 0 && learned < timeout) return learned;
+  return timeout;
+}
+
+// Called as each command finishes. Only an answer tells us anything about
+//  latency; a timeout just tells us the deadline was too short (or that the
+//  module's gone away, in which case backing off doesn't hurt).
+void BLEMate2::learnLatency(cmdEntry *cmd, opResult result)
+{
+  byte slot = adaptSlot(cmd->type);
+  if (slot == ADAPT_NONE || !cmd->written || slowCommand(cmd)) return;
+  if (result == TIMEOUT_ERROR)
+  {
+    if (_latency8[slot] < 0x8000) _latency8[slot] <<= 1;
+    return;
+  }
+  if (result != SUCCESS && result != MODULE_ERROR) return;
+
+  unsigned long elapsed = millis() - cmd->start;
+  if (elapsed > 4000) elapsed = 4000; // Keeps the sums in an unsigned int.
+  if (_latencySamples[slot] == 0)
+  {
+    _latency8[slot] = elapsed << 3;
+    _deviation4[slot] = elapsed << 1;
+  }
+  else
+  {
+    int error = (int)elapsed - (int)(_latency8[slot] >> 3);
+    _latency8[slot] += error;
+    if (error < 0) error = -error;
+    _deviation4[slot] += error - (int)(_deviation4[slot] >> 2);
+  }
+  if (_latencySamples[slot] < 255) _latencySamples[slot]++;
+}
+
+// Reports the number of times we've had to resynchronize with the module.
+//  If this climbs steadily, something is garbling the serial link.
+unsigned int BLEMate2::resyncCount()
+{
+  return _resyncCount;
+}
@@ -0,0 +1,270 @@
+/****************************************************************
+Configuration snapshots for BC118 modules.
+
+Reading a dozen parameters one stdGetParam() at a time, comparing
+them by hand and writing back the ones that are wrong gets old
+fast. This does it in one go.
+
+This code is beerware; if you use it, please buy me (or any other
+SparkFun employee) a cold beverage next time you run into one of
+us at the local.
+
+Code developed in Arduino 1.0.6, on an Arduino Pro 5V.
+****************************************************************/
+
+#include "SparkFunBLEMate2.h"
+#include <Arduino.h>
+
+// The module's name for each setting in a BLEMate2Config, in configField
+//  order.
+static const char configNames[BLEMate2::CONFIG_FIELDS][5] PROGMEM =
+  {"UART", "CENT", "ACON", "CCON", "SCNT", "ADVP", "ADVT", "ADDR", "NAME"};
+
+// Changes to these don't mean anything until the module's been reset; the
+//  others take effect right away (though, like everything else, they have to
+//  be written to NVM to survive a power cycle).
+#define CONFIG_NEEDS_RESET ((1 << BLEMate2::CONFIG_CENT) | \
+                            (1 << BLEMate2::CONFIG_ADVP) | \
+                            (1 << BLEMate2::CONFIG_ADDR) | \
+                            (1 << BLEMate2::CONFIG_NAME))
+
+// Big enough for the text of any setting: the name, or an address.
+#if BLE_MATE2_NAME_SIZE > 13
+#define CONFIG_TEXT_SIZE BLE_MATE2_NAME_SIZE
+#else
+#define CONFIG_TEXT_SIZE 13
+#endif
+
+// Get the module ready to go, as quickly as it can be. The usual way of doing
+//  that is reset(), restore(), writeConfig(), reset() and then a pile of
+//  settings and another write and reset, which is a lot of waiting; most of
+//  the time, though, the module was set up last time we ran and kept its
+//  settings through the power cycle. So we ask first: if the module answers
+//  and its settings match desired, we're done without a single reset. If some
+//  of them differ, only those get set, and the module is only reset if one
+//  of those needs it. We only reset up front if the module won't answer at
+//  all, and then we pick up as soon as it says READY.
+BLEMate2::opResult BLEMate2::fastBegin(const BLEMate2Config &desired)
+{
+  BLEMate2Config current = desired;
+  opResult result = readConfig(current);
+  if (result != SUCCESS)
+  {
+    result = reset();
+    if (result == SUCCESS) result = readConfig(current);
+    if (result != SUCCESS) return result;
+  }
+  return applyConfig(desired, current);
+}
+
+// Read all the settings in a BLEMate2Config from the module. The GETs are
+//  queued as one batch, so they go out back to back rather than each one
+//  waiting on the last; if any of them fails, the rest are dropped and we
+//  report the failure. Fields we don't get an answer for are left alone.
+BLEMate2::opResult BLEMate2::readConfig(BLEMate2Config &config)
+{
+  // Like the other blocking functions, this can't be used from inside
+  //  poll(). Otherwise, start from an empty queue, so the result is ours and
+  //  nobody else's.
+  if (_polling) return BUSY_ERROR;
+  waitForIdle();
+  beginBatch();
+  for (byte i = 0; i < CONFIG_FIELDS; i++)
+  {
+    // newCommand() polls, and the reconnect supervisor or a callback can
+    //  take the room we just waited for. If so, we give up on the lot; the
+    //  GETs already on the wire still write into config, so they have to
+    //  finish before we hand it back.
+    cmdEntry *cmd = NULL;
+    if (waitForRoom() == SUCCESS) cmd = newCommand(CMD_CONFIG, 2000);
+    if (cmd == NULL)
+    {
+      abandonBatch();
+      waitForIdle();
+      return BUSY_ERROR;
+    }
+    buildCmd(cmd, ID_GET, configNames[i], NULL, FLASH_ARG1);
+    cmd->out.config = &config;
+    cmd->arg = i;
+    queueCommand(cmd);
+  }
+  endBatch();
+  return waitForIdle();
+}
+
+// Make the module's settings match desired. current is what the module has
+//  now (from readConfig(), usually); only the settings that differ get sent,
+//  and if nothing differs, we don't talk to the module at all. If anything
+//  changed, we write the settings to NVM, and if any of the changes needs a
+//  reset to take effect, we reset the module too. On success, current is
+//  updated to match. The SETs, the WRT and the RST all go in one batch, so
+//  an ERR on any of them stops everything queued behind it; a SET that
+//  fails never gets as far as NVM.
+// The baud rate is the exception: changing that takes cooperation from the
+//  Arduino's end of the link, so it's left alone here. Use autoBaud() or
+//  setBaudRate() for that.
+BLEMate2::opResult BLEMate2::applyConfig(const BLEMate2Config &desired,
+                                         BLEMate2Config &current)
+{
+  unsigned int changes = diffConfig(desired, current) &
+                         ~(1 << CONFIG_UART);
+  if (changes == 0) return SUCCESS;
+
+  // Check that everything will fit before we send any of it; a half-applied
+  //  configuration is worse than none at all. "SET xxxx=" is 9 characters.
+  char text[CONFIG_TEXT_SIZE];
+  for (byte i = 0; i < CONFIG_FIELDS; i++)
+  {
+    if (!(changes & (1 << i))) continue;
+    configText(desired, i, text);
+    if (strlen(text) + 9 >= BLE_MATE2_CMD_SIZE) return INVALID_PARAM;
+  }
+
+  if (_polling) return BUSY_ERROR;
+  waitForIdle();
+  beginBatch();
+  for (byte i = 0; i < CONFIG_FIELDS; i++)
+  {
+    if (!(changes & (1 << i))) continue;
+    // As in readConfig(), the room we wait for can be gone by the time we
+    //  try to use it. What's left of the batch is dropped, so the WRT never
+    //  goes out behind a partial set of changes.
+    cmdEntry *cmd = NULL;
+    if (waitForRoom() == SUCCESS) cmd = newCommand(CMD_STD, 2000);
+    if (cmd == NULL) return abandonBatch();
+    configText(desired, i, text);
+    buildCmd(cmd, ID_SET, configNames[i], text, FLASH_ARG1);
+    queueCommand(cmd);
+  }
+  if (waitForRoom() != SUCCESS || beginWriteConfig() != SUCCESS)
+  {
+    return abandonBatch();
+  }
+  if (changes & CONFIG_NEEDS_RESET)
+  {
+    if (waitForRoom() != SUCCESS || beginReset() != SUCCESS)
+    {
+      return abandonBatch();
+    }
+  }
+  endBatch();
+  opResult result = waitForIdle();
+
+  if (result == SUCCESS)
+  {
+    unsigned long baudRate = current.baudRate;
+    current = desired;
+    current.baudRate = baudRate;
+  }
+  return result;
+}
+
+// Compare two configurations. Each setting that differs sets the bit for its
+//  configField in the result, so 0 means they're the same.
+unsigned int BLEMate2::diffConfig(const BLEMate2Config &a,
+                                  const BLEMate2Config &b)
+{
+  unsigned int changes = 0;
+  if (a.baudRate != b.baudRate) changes |= 1 << CONFIG_UART;
+  if (!a.central != !b.central) changes |= 1 << CONFIG_CENT;
+  if (!a.autoConnect != !b.autoConnect) changes |= 1 << CONFIG_ACON;
+  if (!a.advertiseOnDisconnect != !b.advertiseOnDisconnect)
+  {
+    changes |= 1 << CONFIG_CCON;
+  }
+  if (a.scanTimeout != b.scanTimeout) changes |= 1 << CONFIG_SCNT;
+  if (!a.fastAdvertising != !b.fastAdvertising) changes |= 1 << CONFIG_ADVP;
+  if (a.advertiseTimeout != b.advertiseTimeout) changes |= 1 << CONFIG_ADVT;
+  if (memcmp(a.allowAddress, b.allowAddress, 6) != 0)
+  {
+    changes |= 1 << CONFIG_ADDR;
+  }
+  if (strncmp(a.name, b.name, BLE_MATE2_NAME_SIZE) != 0)
+  {
+    changes |= 1 << CONFIG_NAME;
+  }
+  return changes;
+}
+
+// Called by commandLine() with the value from a "name=value" line, to put it
+//  in the right field.
+void BLEMate2::storeConfig(BLEMate2Config *config, byte field,
+                           const char *value)
+{
+  boolean on = strncmp_P(value, PSTR("ON"), 2) == 0;
+  switch (field)
+  {
+    case CONFIG_UART:
+      config->baudRate = baudFromCode(value);
+      break;
+    case CONFIG_CENT:
+      config->central = on;
+      break;
+    case CONFIG_ACON:
+      config->autoConnect = on;
+      break;
+    case CONFIG_CCON:
+      config->advertiseOnDisconnect = on;
+      break;
+    case CONFIG_SCNT:
+      config->scanTimeout = strtoul(value, NULL, 10);
+      break;
+    case CONFIG_ADVP:
+      config->fastAdvertising = strncmp_P(value, PSTR("FAST"), 4) == 0;
+      break;
+    case CONFIG_ADVT:
+      config->advertiseTimeout = strtoul(value, NULL, 10);
+      break;
+    case CONFIG_ADDR:
+      parseAddress(value, config->allowAddress);
+      break;
+    case CONFIG_NAME:
+    {
+      byte len = 0;
+      while (value[len] != '\0' && len < BLE_MATE2_NAME_SIZE - 1)
+      {
+        config->name[len] = value[len];
+        len++;
+      }
+      while (len > 0 && config->name[len-1] == ' ') len--;
+      config->name[len] = '\0';
+      break;
+    }
+  }
+}
+
+// And the other way: the text the module wants for a setting. text must have
+//  room for CONFIG_TEXT_SIZE characters.
+void BLEMate2::configText(const BLEMate2Config &config, byte field,
+                          char *text)
+{
+  text[0] = '\0';
+  switch (field)
+  {
+    case CONFIG_CENT:
+      strcpy_P(text, config.central ? PSTR("ON") : PSTR("OFF"));
+      break;
+    case CONFIG_ACON:
+      strcpy_P(text, config.autoConnect ? PSTR("ON") : PSTR("OFF"));
+      break;
+    case CONFIG_CCON:
+      strcpy_P(text, config.advertiseOnDisconnect ? PSTR("ON") : PSTR("OFF"));
+      break;
+    case CONFIG_SCNT:
+      utoa(config.scanTimeout, text, 10);
+      break;
+    case CONFIG_ADVP:
+      strcpy_P(text, config.fastAdvertising ? PSTR("FAST") : PSTR("SLOW"));
+      break;
+    case CONFIG_ADVT:
+      utoa(config.advertiseTimeout, text, 10);
+      break;
+    case CONFIG_ADDR:
+      formatAddress(config.allowAddress, text);
+      break;
+    case CONFIG_NAME:
+      strncpy(text, config.name, CONFIG_TEXT_SIZE - 1);
+      text[CONFIG_TEXT_SIZE - 1] = '\0';
+      break;
+  }
+}
@@ -21,131 +21,354 @@ Code developed in Arduino 1.0.6, on an Arduino Pro 5V.
 //  the "BLEPeripheral()" function.
 BLEMate2::opResult BLEMate2::BLEAdvertise()
 {
-  return stdCmd("ADV ON");
+  return stdCmd(F("ADV ON"));
 }
 
 BLEMate2::opResult BLEMate2::BLENoAdvertise()
 {
-  return stdCmd("ADV OFF");
+  return stdCmd(F("ADV OFF"));
 }
 
 // With the BC118, *scan* is a much more important thing that with the BC127.
 //  It's a "state", and in order to initiate a connection as a central device,
 //  the BC118 *must* be in scan state.
-// Timeout is not inherent to the scan command, either; that's a separate 
+// Timeout is not inherent to the scan command, either; that's a separate
 //  parameter that needs to be set.
 BLEMate2::opResult BLEMate2::BLEScan(unsigned int timeout)
 {
+  if (waitForRoom() != SUCCESS) return BUSY_ERROR;
+  return blockUntilDone(beginScan(timeout));
+}
+
+// The scan itself is run by the command engine: first "SET SCNT", then
+//  "SCN ON", then collecting addresses from the SCN= lines as they come in.
+//  See commandLine() for the parsing.
+BLEMate2::opResult BLEMate2::beginScan(unsigned int timeout)
+{
+  cmdEntry *cmd = newCommand(CMD_SCAN, 2000);
+  if (cmd == NULL) return BUSY_ERROR;
+
+  char timeoutText[6];
+  utoa(timeout, timeoutText, 10);
+  buildCmd(cmd, ID_SCNT, timeoutText);
 
   // Let's assume that we find nothing; we'll call that a REMOTE_ERROR and
   //  report that to the user. Should we find something, we'll report success.
-  opResult result = REMOTE_ERROR;
-  String buffer = "";
-  String addressTemp;
-  String EOL = String("\n\r");
-  
-  String timeoutString = String(timeout, DEC);
-  stdSetParam("SCNT", timeoutString);
-  for (byte i = 0; i <5; i++) _addresses[i] = "";
-  _numAddresses = 0;
-    
-  knownStart();
-  
-  // Now issue the scan command. 
-  _serialPort->print("SCN ON\r");
-  _serialPort->flush();
-  
-  // We're going to use the internal timer to track the elapsed time since we
-  //  issued the command. Bog-standard Arduino stuff.
-  unsigned long loopStart = millis();
-  
+  cmd->result = REMOTE_ERROR;
+
   // Calculate a timeout value that's a tish longer than the module will
-  //  use. This is our catch-all, so we don't sit in this loop forever waiting
-  //  for input that will never come from the module.
-  unsigned long loopTimeout = timeout*1300;
-  
-  // Oooookaaaayyy...now the fun part. A state machine that parses the input
-  //  from the Bluetooth module!
-  while (loopStart + loopTimeout > millis())
+  //  use. This is our catch-all, so we don't sit here forever waiting
+  //  for input that will never come from the module. A timeout of 0 means
+  //  the module scans until it's told to stop, so that's just the same as
+  //  startScanning(): we're done once the scan is on, and the table is
+  //  kept as it is. Only a timed scan starts from an empty one.
+  cmd->arg = timeout*1300UL;
+
+  return queueCommand(cmd);
+}
+
+// Continuous scanning. Rather than scanning for a while and reporting what
+//  we found, this leaves the module scanning and returns as soon as it's
+//  started; from then on, poll() keeps the scan table up to date as reports
+//  come in. Use onDeviceAppear()/onDeviceDisappear() and setScanAging() to
+//  keep track of who comes and goes.
+BLEMate2::opResult BLEMate2::startScanning()
+{
+  if (waitForRoom() != SUCCESS) return BUSY_ERROR;
+  return blockUntilDone(beginStartScanning());
+}
+
+BLEMate2::opResult BLEMate2::beginStartScanning()
+{
+  cmdEntry *cmd = newCommand(CMD_SCAN, 2000);
+  if (cmd == NULL) return BUSY_ERROR;
+  buildCmd(cmd, ID_SCNT, PSTR("0"), NULL, FLASH_ARG1);
+  cmd->arg = 0;
+  return queueCommand(cmd);
+}
+
+BLEMate2::opResult BLEMate2::stopScanning()
+{
+  return stdCmd(F("SCN OFF"));
+}
+
+BLEMate2::opResult BLEMate2::beginStopScanning()
+{
+  return beginStdCmd(F("SCN OFF"));
+}
+
+// A device that hasn't been heard from in maxAge milliseconds is taken out of
+//  the scan table, and the onDeviceDisappear() function (if any) is told.
+//  0, the default, means devices stay until they're pushed out by new ones.
+void BLEMate2::setScanAging(unsigned long maxAge)
+{
+  _scanMaxAge = maxAge;
+}
+
+void BLEMate2::onDeviceAppear(scanCallback callback)
+{
+  _appearCallback = callback;
+}
+
+// This also gets called for devices pushed out of a full table, since as far
+//  as the table is concerned, they're gone.
+void BLEMate2::onDeviceDisappear(scanCallback callback)
+{
+  _disappearCallback = callback;
+}
+
+// Called from every poll(). To keep poll() quick no matter how big the table
+//  is, we only look at a couple of entries each time around.
+void BLEMate2::ageScanTable()
+{
+  if (_scanMaxAge == 0) return;
+  for (byte i = 0; i < 2 && _scanCount > 0; i++)
   {
-    // Grow the current buffered data, until we receive the EOL string.    
-    if (_serialPort->available() >0)
+    if (_ageCursor >= _scanCount) _ageCursor = 0;
+    if (millis() - _scanTable[_ageCursor].lastSeen >= _scanMaxAge)
     {
-      buffer.concat(char(_serialPort->read()));
+      removeScanEntry(_ageCursor);
     }
-    if (buffer.endsWith(EOL))
+    else _ageCursor++;
+  }
+}
+
+// Take an entry out of the scan table. The last entry moves into its place,
+//  so the table stays packed; that means entry numbers can change whenever a
+//  device goes away.
+void BLEMate2::removeScanEntry(byte slot)
+{
+  scanEntry gone = _scanTable[slot];
+  byte last = _scanCount - 1;
+  for (byte i = 0; i < _scanCount; i++)
+  {
+    if (_scanIndex[i] != slot) continue;
+    memmove(&_scanIndex[i], &_scanIndex[i+1], last - i);
+    break;
+  }
+  if (slot != last)
+  {
+    _scanTable[slot] = _scanTable[last];
+    for (byte i = 0; i < last; i++)
     {
-      // There are two possibilities for return values:
-      //  1. ERR - indicates a problem with the module. Either we're in the
-      //           wrong state to be trying to do this (we're not central,
-      //           not idle, or both) or there's a syntax error.
-      //  2. SCN=X 12charaddrxx xxxxxxxxxxxxxxx\n\r
-      //           In this case, all we care about is the content from char
-      //           6 to 18.
-      // Note the lack of any kind of completion string! The module just stops
-      //  reporting when done, and we'll never know if it doesn't find anything
-      //  to report.
-      if (buffer.startsWith("ER")) 
-      {
-        return MODULE_ERROR;
-      }
-      else if (buffer.startsWith("SC")) // An address has been found!
+      if (_scanIndex[i] == last) _scanIndex[i] = slot;
+    }
+  }
+  _scanCount--;
+  if (_disappearCallback != NULL) _disappearCallback(gone);
+}
+
+// Called by the command engine with an SCN= line in the line buffer. The
+//  returned device string looks like this:
+//    SCN=? 12charaddrxx name -rssi advertising data
+//  We used to keep the first five addresses we saw as Strings and throw the
+//  rest of the line away. Now every device goes into the scan table, as a
+//  6-byte address with its signal strength, when we last heard from it and
+//  how many times we have. The table is kept in address order through
+//  _scanIndex, so finding a device we've seen before is a binary search
+//  rather than a string compare against every entry.
+void BLEMate2::recordScanResult()
+{
+  byte address[6];
+  if (_lineLen < 18 || !parseAddress(&_lineBuf[6], address)) return;
+  int8_t rssi = parseRssi();
+
+  byte pos;
+  if (findAddress(address, pos))
+  {
+    scanEntry *entry = &_scanTable[_scanIndex[pos]];
+    entry->rssi = rssi;
+    entry->lastSeen = millis();
+    if (entry->hits < 255) entry->hits++;
+    return;
+  }
+
+  // New device. If the table's full, we need to make room for it by
+  //  throwing one out.
+  if (_scanCount >= BLE_MATE2_SCAN_SIZE)
+  {
+    byte victim = scanVictim(rssi);
+    if (victim == 0xFF) return;
+    removeScanEntry(victim);
+    findAddress(address, pos);
+  }
+
+  byte slot = _scanCount++;
+  memmove(&_scanIndex[pos+1], &_scanIndex[pos], _scanCount - 1 - pos);
+  _scanIndex[pos] = slot;
+  scanEntry *entry = &_scanTable[slot];
+  memcpy(entry->address, address, 6);
+  entry->rssi = rssi;
+  entry->lastSeen = millis();
+  entry->hits = 1;
+  if (_appearCallback != NULL) _appearCallback(*entry);
+}
+
+// Pick the entry to throw out of a full table to make room for a device with
+//  the given signal strength. Returns 0xFF if the new device should be the
+//  one left out.
+byte BLEMate2::scanVictim(int8_t rssi)
+{
+  byte victim = 0;
+  for (byte i = 1; i < _scanCount; i++)
+  {
+    if (_scanPolicy == EVICT_OLDEST)
+    {
+      if (_scanTable[i].lastSeen - _scanTable[victim].lastSeen >= 0x80000000UL)
       {
-        // The returned device string looks like this:
-        //  scn=? 12charaddrxx bunch of other stuff\n\r
-        // We can ignore the other stuff, and the first stuff, and just
-        //  report the address. 
-        addressTemp = buffer.substring(6,18);
-        buffer = "";
-        if (_numAddresses == 0) 
-        {
-          _addresses[0] = addressTemp;
-          _numAddresses++;
-          result = SUCCESS;
-        }
-        else // search the list for this address, and append if it's not in
-             //  the list and the list isn't too long.
-        {
-          for (byte i = 0; i < _numAddresses; i++)
-          {
-            if (addressTemp == _addresses[i])
-            {
-              addressTemp = "x";
-              break;
-            }
-          }
-          if (addressTemp != "x")
-          {
-            _addresses[_numAddresses++] = addressTemp;
-          }
-          if (_numAddresses == 5) return SUCCESS;
-        }
+        victim = i;
       }
-      else // buffer is not a valid value
+    }
+    else if (_scanTable[i].rssi < _scanTable[victim].rssi) victim = i;
+  }
+  if (_scanPolicy == EVICT_WEAKEST && _scanTable[victim].rssi >= rssi)
+  {
+    return 0xFF;
+  }
+  return victim;
+}
+
+// Binary search of the address index. Returns true if the address is in the
+//  table; either way, pos is left where it is (or would go) in _scanIndex.
+boolean BLEMate2::findAddress(const byte *address, byte &pos)
+{
+  byte lo = 0;
+  byte hi = _scanCount;
+  while (lo < hi)
+  {
+    byte mid = (lo + hi) / 2;
+    int cmp = memcmp(_scanTable[_scanIndex[mid]].address, address, 6);
+    if (cmp == 0)
+    {
+      pos = mid;
+      return true;
+    }
+    if (cmp < 0) lo = mid + 1;
+    else hi = mid;
+  }
+  pos = lo;
+  return false;
+}
+
+// Turn the 12 hex digits of an address into 6 bytes. Returns false if any of
+//  them isn't a hex digit.
+boolean BLEMate2::parseAddress(const char *text, byte *address)
+{
+  for (byte i = 0; i < 12; i++)
+  {
+    char c = text[i];
+    byte nibble;
+    if (c >= '0' && c <= '9') nibble = c - '0';
+    else if (c >= 'A' && c <= 'F') nibble = c - 'A' + 10;
+    else if (c >= 'a' && c <= 'f') nibble = c - 'a' + 10;
+    else return false;
+    if (i & 1) address[i/2] |= nibble;
+    else address[i/2] = nibble << 4;
+  }
+  return true;
+}
+
+// And back again, as the 12 uppercase hex digits the module wants. text must
+//  have room for 13 characters.
+void BLEMate2::formatAddress(const byte *address, char *text)
+{
+  static const char hex[] PROGMEM = "0123456789ABCDEF";
+  for (byte i = 0; i < 6; i++)
+  {
+    text[i*2] = pgm_read_byte(&hex[address[i] >> 4]);
+    text[i*2+1] = pgm_read_byte(&hex[address[i] & 0x0F]);
+  }
+  text[12] = '\0';
+}
+
+// The signal strength is the last thing on the line that looks like a
+//  negative number. The name comes before it, and could be anything; the
+//  advertising data after it is all hex. If we can't find it, we call it
+//  -128, which is weaker than anything real.
+int8_t BLEMate2::parseRssi()
+{
+  int8_t rssi = -128;
+  for (byte i = 18; i + 2 < _lineLen; i++)
+  {
+    if (_lineBuf[i] == ' ' && _lineBuf[i+1] == '-' &&
+        _lineBuf[i+2] >= '0' && _lineBuf[i+2] <= '9')
+    {
+      rssi = -atoi(&_lineBuf[i+2]);
+    }
+  }
+  return rssi;
+}
+
+// When the table is full, a new device either pushes out the weakest one we
+//  know about (if it's stronger), or the one we've heard from least recently.
+void BLEMate2::setScanPolicy(scanPolicy policy)
+{
+  _scanPolicy = policy;
+}
+
+// Copy up to n entries from the scan table into list, strongest signal
+//  first. Returns the number copied. This works from whatever's in the
+//  table; there's no need to scan again.
+byte BLEMate2::strongest(scanEntry *list, byte n)
+{
+  if (n > _scanCount) n = _scanCount;
+  byte lastIndex = 0;
+  for (byte i = 0; i < n; i++)
+  {
+    // Strongest entry that isn't stronger than the last one we took (or
+    //  equally strong but further along in the table, so ties come out in
+    //  table order).
+    byte best = 0xFF;
+    for (byte j = 0; j < _scanCount; j++)
+    {
+      if (i > 0)
       {
-        buffer = "";
+        int8_t last = list[i-1].rssi;
+        if (_scanTable[j].rssi > last) continue;
+        if (_scanTable[j].rssi == last && j <= lastIndex) continue;
       }
+      if (best == 0xFF || _scanTable[j].rssi > _scanTable[best].rssi) best = j;
     }
+    if (best == 0xFF) return i;
+    list[i] = _scanTable[best];
+    lastIndex = best;
   }
-  // result will either have been unchanged (we didn't see anything) and
-  //  be REMOTE_ERROR or will have been changed to SUCCESS when we saw our
-  //  first address.
-  return result;
+  return n;
+}
+
+// Gets one entry from the scan table, by index.
+BLEMate2::opResult BLEMate2::getScanEntry(byte index, scanEntry &entry)
+{
+  if (index >= _scanCount) return INVALID_PARAM;
+  entry = _scanTable[index];
+  return SUCCESS;
 }
 
 // connect by index
-//  Attempts to connect to one of the Bluetooth devices which has an address
-//  stored in the _addresses array.
+//  Attempts to connect to one of the Bluetooth devices in the scan table.
 BLEMate2::opResult BLEMate2::connect(byte index)
 {
-  if (index >= _numAddresses) return INVALID_PARAM;
-  else return connect(_addresses[index]);
+  if (waitForRoom() != SUCCESS) return BUSY_ERROR;
+  return blockUntilDone(beginConnect(index));
+}
+
+BLEMate2::opResult BLEMate2::beginConnect(byte index)
+{
+  String address;
+  if (getAddress(index, address) != SUCCESS) return INVALID_PARAM;
+  else return beginConnect(address);
 }
 
 // connect by address
-//  Attempts to connect to one of the Bluetooth devices which has an address
-//  stored in the _addresses array.
+//  Attempts to connect to the Bluetooth device with the given address, which
+//  doesn't need to be in the scan table.
 BLEMate2::opResult BLEMate2::connect(String address)
+{
+  if (waitForRoom() != SUCCESS) return BUSY_ERROR;
+  return blockUntilDone(beginConnect(address));
+}
+
+BLEMate2::opResult BLEMate2::beginConnect(String address)
 {
   // Before we go any further, we'll do a simple error check on the incoming
   //  address. We know that it should be 12 hex digits, all uppercase; to
@@ -153,45 +376,67 @@ BLEMate2::opResult BLEMate2::connect(String address)
   //  characters in length.
   if (address.length() != 12) return INVALID_PARAM;
 
-  // We need a buffer to store incoming data.
-  String buffer;
-  String EOL = String("\n\r"); // This is just handy.
-  
-  
-  knownStart(); // Purge serial buffers on both the module and the Arduino.
-  
-  // The module has to be in SCAN mode for the CON command to work.
-  //  We can't use BLEScan() b/c it's a blocking function.
-  _serialPort->print("SCN ON\r");
-  
-  // Now issue the inquiry command.
-  _serialPort->print("CON "); 
-  _serialPort->print(address);
-  _serialPort->print(" 0\r");
-  // We need to wait until the command finishes before we start looking for a
-  //  response; that's what flush() does.
-  _serialPort->flush();
-  
-  // We're going to use the internal timer to track the elapsed time since we
-  //  issued the connect command. Bog-standard Arduino stuff.
-  unsigned long connectStart = millis();
-  
-  buffer = "";
+  // The module gets 2 seconds to start scanning; after that, the timeout on
+  //  the connection itself is 5 seconds, which may be a bit long.
+  cmdEntry *cmd = newCommand(CMD_CONNECT, 2000);
+  if (cmd == NULL) return BUSY_ERROR;
 
-  // The timeout on this is 5 seconds; that may be a bit long.
-  while (connectStart + 5000 > millis())
+  // The engine will put the module in SCAN mode before sending this; the
+  //  CON command doesn't work otherwise.
+  buildCmd(cmd, ID_CON, address.c_str());
+  return queueCommand(cmd);
+}
+
+// connect by filter
+//  Rather than scanning, picking a device from the list and then connecting
+//  to it, this starts a scan and connects to the first device that fits the
+//  filter, the moment we hear from it. If nothing fits within timeout
+//  milliseconds, the result is REMOTE_ERROR. The filter must stay in scope
+//  until the connection is made (or not).
+BLEMate2::opResult BLEMate2::connect(const connectFilter &filter,
+                                     unsigned long timeout)
+{
+  if (waitForRoom() != SUCCESS) return BUSY_ERROR;
+  return blockUntilDone(beginConnect(filter, timeout));
+}
+
+BLEMate2::opResult BLEMate2::beginConnect(const connectFilter &filter,
+                                          unsigned long timeout)
+{
+  cmdEntry *cmd = newCommand(CMD_CONNECT, 2000);
+  if (cmd == NULL) return BUSY_ERROR;
+  cmd->out.filter = &filter;
+  cmd->arg = timeout;
+  return queueCommand(cmd);
+}
+
+// Does the SCN= line in the line buffer fit the filter? A device fits if the
+//  address bits set in the mask match the filter's address, the signal is at
+//  least minRssi, and the name starts with namePrefix. An all-zero mask,
+//  a minRssi of -128 and a NULL namePrefix match anything.
+boolean BLEMate2::matchFilter(const connectFilter *filter)
+{
+  byte address[6];
+  if (_lineLen < 18 || !parseAddress(&_lineBuf[6], address)) return false;
+  for (byte i = 0; i < 6; i++)
   {
-    // Grow the current buffered data, until we receive the EOL string.    
-    if (_serialPort->available() >0) buffer.concat(char(_serialPort->read()));
-    
-    if (buffer.endsWith(EOL))
-    {
-      if (buffer.startsWith("ERR")) return MODULE_ERROR;
-      if (buffer.startsWith("RPD")) return SUCCESS;
-      buffer = "";    
-    }
+    if ((address[i] ^ filter->address[i]) & filter->mask[i]) return false;
   }
-  return TIMEOUT_ERROR;
+  if (parseRssi() < filter->minRssi) return false;
+  if (filter->namePrefix != NULL)
+  {
+    size_t len = strlen(filter->namePrefix);
+    if (_lineLen < 19 + len) return false;
+    if (strncmp(&_lineBuf[19], filter->namePrefix, len) != 0) return false;
+  }
+  return true;
+}
+
+// How long the last successful connect() took, in milliseconds, from
+//  starting the scan to the module reporting the connection.
+unsigned long BLEMate2::connectLatency()
+{
+  return _connectLatency;
 }
 
 // Gets an address from the array of stored addresses. The return value allows
@@ -199,60 +444,168 @@ BLEMate2::opResult BLEMate2::connect(String address)
 //  requested index.
 BLEMate2::opResult BLEMate2::getAddress(byte index, String &address)
 {
-  if (index+1 > _numAddresses)
+  if (index+1 > _scanCount)
   {
-    String tempString = "";
-    address = tempString;
+    address = "";
     return INVALID_PARAM;
   }
-  else address = _addresses[index];
+  char text[13];
+  formatAddress(_scanTable[index].address, text);
+  address = text;
   return SUCCESS;
 }
 
 // Gets the number of addresses we've found.
 byte BLEMate2::numAddresses()
 {
-  return _numAddresses;
+  return _scanCount;
 }
 
 
 
+// Are we connected? We keep track of that from what the module tells us:
+//  "RPD" when a connection is made (by us or by the remote device), "DCN"
+//  when it's lost or closed. SUCCESS means connected, CONNECT_ERROR means
+//  not.
 BLEMate2::opResult BLEMate2::connectionState()
 {
-  return TIMEOUT_ERROR;
+  return _linkUp ? SUCCESS : CONNECT_ERROR;
 }
 
-BLEMate2::opResult BLEMate2::disconnect()
+// Called by the event dispatcher (and by reset) when the link comes up or
+//  goes down. Besides keeping the up and down time totals, this is what sets
+//  the reconnect supervisor going.
+void BLEMate2::setLinkState(boolean up)
 {
-  String buffer;
-  String EOL = String("\n\r"); // This is just handy.
-  
-  knownStart();
-  _serialPort->print("DCN\r"); 
-  _serialPort->flush();
-  
-  // We're going to use the internal timer to track the elapsed time since we
-  //  issued the connect command. Bog-standard Arduino stuff.
-  unsigned long disconnectStart = millis();
-  
-  buffer = "";
+  if (up == _linkUp) return;
+  unsigned long now = millis();
+  if (_linkUp) _upTotal += now - _linkSince;
+  else _downTotal += now - _linkSince;
+  _linkSince = now;
+  _linkUp = up;
 
-  // The timeout on this is 5 seconds; that may be a bit long.
-  while (disconnectStart + 5000 > millis())
+  // A link that's just dropped gets its first reconnect attempt after the
+  //  shortest delay.
+  if (!up)
   {
-    // Grow the current buffered data, until we receive the EOL string.    
-    if (_serialPort->available() >0) buffer.concat(char(_serialPort->read()));
-    
-    if (buffer.endsWith(EOL))
-    {
-      if (buffer.startsWith("ERR")) return MODULE_ERROR;
-      if (buffer.startsWith("DCN")) 
-      {
-        stdCmd("SCN OFF"); 
-        return SUCCESS;
-      }
-      buffer = "";    
-    }
+    _reconnectDelay = _reconnectMin;
+    _reconnectAt = now + _reconnectDelay;
   }
-  return TIMEOUT_ERROR;
+}
+
+// Total time, in milliseconds, the link has been up (or down) since the
+//  BLEMate2 object was created. These will roll over after about 49 days.
+unsigned long BLEMate2::linkUptime()
+{
+  if (_linkUp) return _upTotal + (millis() - _linkSince);
+  return _upTotal;
+}
+
+unsigned long BLEMate2::linkDowntime()
+{
+  if (_linkUp) return _downTotal;
+  return _downTotal + (millis() - _linkSince);
+}
+
+// The reconnect supervisor. Once this is turned on, whenever the link is
+//  down, poll() will try to connect to the given address, waiting a little
+//  longer after each failure (see setReconnectBackoff()). It never blocks;
+//  the attempts are queued like any other command, and only when the queue
+//  is empty, so they'll show up in onComplete() like any other command.
+//  Without an address, it uses the last one we connected to successfully.
+//  disconnect() turns it off again.
+void BLEMate2::autoReconnect(String address)
+{
+  if (address.length() != 12 || !parseAddress(address.c_str(), _peer))
+  {
+    return;
+  }
+  _havePeer = true;
+  autoReconnect();
+}
+
+void BLEMate2::autoReconnect()
+{
+  if (!_havePeer) return;
+  _reconnect = true;
+  _reconnectDelay = _reconnectMin;
+  _reconnectAt = millis();
+}
+
+// The first attempt after the link drops comes minDelay milliseconds later.
+//  Each failure after that doubles the delay, up to maxDelay, and each delay
+//  gets some more added at random (see setReconnectJitter()), so that a room
+//  full of devices that lost their peers at the same moment don't all retry
+//  in step.
+void BLEMate2::setReconnectBackoff(unsigned long minDelay,
+                                   unsigned long maxDelay)
+{
+  if (minDelay == 0) minDelay = 1;
+  if (maxDelay < minDelay) maxDelay = minDelay;
+  _reconnectMin = minDelay;
+  _reconnectMax = maxDelay;
+}
+
+// How much, at most, gets added to each delay after a failure, as a
+//  percentage of the delay; 25, a quarter again, unless you say otherwise. 0
+//  turns it off, for when there's only the one device and you'd rather the
+//  retries came like clockwork. It can't be more than 100.
+void BLEMate2::setReconnectJitter(byte percent)
+{
+  if (percent > 100) percent = 100;
+  _reconnectJitter = percent;
+}
+
+// The number of connections the supervisor has managed to restore.
+unsigned int BLEMate2::reconnectCount()
+{
+  return _reconnects;
+}
+
+// Called from every poll(). If the link's down and it's time for another
+//  try, queue one up.
+void BLEMate2::superviseLink()
+{
+  if (!_reconnect || _linkUp || _qCount > 0) return;
+  if ((long)(millis() - _reconnectAt) < 0) return;
+
+  char address[13];
+  formatAddress(_peer, address);
+  if (beginConnect(String(address)) == SUCCESS) _reconnectSeq = _seq;
+}
+
+// Called by popCommand() when one of the supervisor's attempts is done.
+void BLEMate2::reconnectResult(opResult result)
+{
+  if (result == SUCCESS)
+  {
+    _reconnects++;
+    return;
+  }
+  _reconnectDelay *= 2;
+  if (_reconnectDelay > _reconnectMax) _reconnectDelay = _reconnectMax;
+  // Worked out in two parts, so a long delay can't overflow on the way.
+  unsigned long spread = (_reconnectDelay / 100) * _reconnectJitter +
+                         (_reconnectDelay % 100) * _reconnectJitter / 100;
+  _reconnectAt = millis() + _reconnectDelay + random(spread + 1);
+}
+
+BLEMate2::opResult BLEMate2::disconnect()
+{
+  if (waitForRoom() != SUCCESS) return BUSY_ERROR;
+  return blockUntilDone(beginDisconnect());
+}
+
+// Once the module reports "DCN", the engine follows up with "SCN OFF". If
+//  we're disconnecting on purpose, we don't want the supervisor undoing it.
+//  If the disconnect doesn't get queued, though, nothing's changed, and the
+//  supervisor carries on.
+BLEMate2::opResult BLEMate2::beginDisconnect()
+{
+  // The timeout on this is 5 seconds; that may be a bit long.
+  cmdEntry *cmd = newCommand(CMD_DISCONNECT, 5000);
+  if (cmd == NULL) return BUSY_ERROR;
+  buildCmd(cmd, ID_DCN);
+  _reconnect = false;
+  return queueCommand(cmd);
 }
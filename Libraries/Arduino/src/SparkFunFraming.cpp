@@ -0,0 +1,265 @@
+/****************************************************************
+Framing for binary data over a BC118 link
+
+See SparkFunFraming.h for the why. A frame on the wire looks like
+this:
+  END <length> <data> <CRC high> <CRC low> END
+where everything between the ENDs is escaped, SLIP style, so that
+the only END bytes are the ones marking the frame edges and there's
+no \r, \n or null anywhere. The CRC is CRC-16/CCITT (polynomial
+0x1021, starting at 0xFFFF), over the length and the data. The
+leading END costs a byte, but it means a frame that lost a piece
+on the way can't take the next one down with it.
+
+This code is beerware; if you use it, please buy me (or any other
+SparkFun employee) a cold beverage next time you run into one of
+us at the local.
+
+Code developed in Arduino 1.0.6, on an Arduino Pro 5V.
+****************************************************************/
+
+#include "SparkFunFraming.h"
+#include <Arduino.h>
+
+#define FRAME_END     0xC0
+#define FRAME_ESC     0xDB
+#define FRAME_ESC_END 0xDC
+#define FRAME_ESC_ESC 0xDD
+#define FRAME_ESC_CR  0xDE
+#define FRAME_ESC_LF  0xDF
+#define FRAME_ESC_NUL 0xE0
+
+// What a byte turns into after FRAME_ESC, or 0 if it can go as it is.
+static byte escapeCode(byte c)
+{
+  switch (c)
+  {
+    case FRAME_END: return FRAME_ESC_END;
+    case FRAME_ESC: return FRAME_ESC_ESC;
+    case '\r':      return FRAME_ESC_CR;
+    case '\n':      return FRAME_ESC_LF;
+    case '\0':      return FRAME_ESC_NUL;
+  }
+  return 0;
+}
+
+// And back again. Returns -1 for something that isn't an escape code.
+static int unescapeCode(byte c)
+{
+  switch (c)
+  {
+    case FRAME_ESC_END: return FRAME_END;
+    case FRAME_ESC_ESC: return FRAME_ESC;
+    case FRAME_ESC_CR:  return '\r';
+    case FRAME_ESC_LF:  return '\n';
+    case FRAME_ESC_NUL: return '\0';
+  }
+  return -1;
+}
+
+// The CRC has to be kept to 16 bits, or it comes out differently on boards
+//  with a 32-bit int.
+static uint16_t crc16(uint16_t crc, byte c)
+{
+  crc ^= (uint16_t)c << 8;
+  for (byte i = 0; i < 8; i++)
+  {
+    if (crc & 0x8000) crc = (crc << 1) ^ 0x1021;
+    else crc <<= 1;
+  }
+  return crc;
+}
+
+BLEMate2Framer::BLEMate2Framer(BLEMate2 *module)
+{
+  _module = module;
+  _callback = NULL;
+  _rxLen = 0;
+  _rxEscape = false;
+  _rxBad = false;
+  _frames = 0;
+  _badFrames = 0;
+}
+
+// The blocking send waits on its own command, so whatever else is in the
+//  module's queue (and however that goes) doesn't change the result.
+BLEMate2::opResult BLEMate2Framer::sendFrame(const byte *data, byte len)
+{
+  if (_encoder.available() > 0) return BLEMate2::BUSY_ERROR;
+  _encoder.start(data, len);
+  BLEMate2::opResult result =
+    _module->sendData(_encoder, _encoder.available());
+  // If it failed partway (or never started), don't leave the encoder
+  //  thinking it's busy.
+  while (_encoder.read() >= 0);
+  return result;
+}
+
+BLEMate2::opResult BLEMate2Framer::beginSendFrame(const byte *data, byte len)
+{
+  if (_encoder.available() > 0) return BLEMate2::BUSY_ERROR;
+  _encoder.start(data, len);
+  BLEMate2::opResult result =
+    _module->beginSendData(_encoder, _encoder.available());
+  // If it didn't get queued, don't leave the encoder thinking it's busy.
+  if (result != BLEMate2::SUCCESS) while (_encoder.read() >= 0);
+  return result;
+}
+
+void BLEMate2Framer::poll()
+{
+  while (_module->available() > 0)
+  {
+    feed(_module->read());
+  }
+}
+
+void BLEMate2Framer::feed(const char *data, byte len)
+{
+  for (byte i = 0; i < len; i++)
+  {
+    feed(data[i]);
+  }
+}
+
+// One byte at a time, from wherever the data comes from. Nothing but the
+//  receive buffer and a few flags are kept between calls, so a frame can be
+//  fed in as many pieces as it arrives in.
+void BLEMate2Framer::feed(byte c)
+{
+  if (c == FRAME_END)
+  {
+    endFrame();
+    return;
+  }
+  if (_rxEscape)
+  {
+    _rxEscape = false;
+    int u = unescapeCode(c);
+    if (u < 0) _rxBad = true;
+    c = u;
+  }
+  else if (c == FRAME_ESC)
+  {
+    _rxEscape = true;
+    return;
+  }
+  if (_rxLen < sizeof(_rxBuf)) _rxBuf[_rxLen] = c;
+  else _rxBad = true;
+  _rxLen++;
+}
+
+// An END. Anything between the last one and this one had better be a good
+//  frame; if there was nothing at all, this was the END that starts a frame.
+void BLEMate2Framer::endFrame()
+{
+  if (_rxLen > 0)
+  {
+    uint16_t crc = 0xFFFF;
+    for (unsigned int i = 0; i + 2 < _rxLen && !_rxBad; i++)
+    {
+      crc = crc16(crc, _rxBuf[i]);
+    }
+    if (_rxBad || _rxLen < 3 || _rxBuf[0] != _rxLen - 3U ||
+        _rxBuf[_rxLen - 2] != (crc >> 8) ||
+        _rxBuf[_rxLen - 1] != (crc & 0xFF))
+    {
+      _badFrames++;
+    }
+    else
+    {
+      _frames++;
+      if (_callback != NULL) _callback(&_rxBuf[1], _rxBuf[0]);
+    }
+  }
+  _rxLen = 0;
+  _rxEscape = false;
+  _rxBad = false;
+}
+
+void BLEMate2Framer::onFrame(frameCallback callback)
+{
+  _callback = callback;
+}
+
+// Good frames received, and frames thrown away for being too long, failing
+//  their CRC or otherwise not making sense.
+unsigned int BLEMate2Framer::frameCount()
+{
+  return _frames;
+}
+
+unsigned int BLEMate2Framer::badFrameCount()
+{
+  return _badFrames;
+}
+
+BLEMate2Framer::encoder::encoder()
+{
+  _remaining = 0;
+}
+
+// The encoder works through the frame by position: 0 is the leading END,
+//  1 the length, then the data, then the two CRC bytes, then the closing END.
+//  We need the CRC before we get to the end, and the total length up front
+//  (sendData() wants to know how much is coming), so start() goes through
+//  the data once to work both out.
+void BLEMate2Framer::encoder::start(const byte *data, byte len)
+{
+  _data = data;
+  _len = len;
+  _pos = 0;
+  _escaped = -1;
+  _crc = crc16(0xFFFF, len);
+  _remaining = 2 + (escapeCode(len) ? 2 : 1);
+  for (byte i = 0; i < len; i++)
+  {
+    _crc = crc16(_crc, data[i]);
+    _remaining += escapeCode(data[i]) ? 2 : 1;
+  }
+  _remaining += escapeCode(_crc >> 8) ? 2 : 1;
+  _remaining += escapeCode(_crc & 0xFF) ? 2 : 1;
+}
+
+byte BLEMate2Framer::encoder::rawByte(unsigned int pos)
+{
+  if (pos == 1) return _len;
+  if (pos <= _len + 1U) return _data[pos - 2];
+  if (pos == _len + 2U) return _crc >> 8;
+  return _crc & 0xFF;
+}
+
+int BLEMate2Framer::encoder::available()
+{
+  return _remaining;
+}
+
+int BLEMate2Framer::encoder::read()
+{
+  int c = peek();
+  if (c < 0) return c;
+  _remaining--;
+  if (_escaped >= 0) _escaped = -1;
+  else if (c == FRAME_ESC) _escaped = escapeCode(rawByte(_pos++));
+  else _pos++;
+  return c;
+}
+
+int BLEMate2Framer::encoder::peek()
+{
+  if (_remaining == 0) return -1;
+  if (_escaped >= 0) return _escaped;
+  if (_pos == 0 || _pos == _len + 4U) return FRAME_END;
+  byte c = rawByte(_pos);
+  return escapeCode(c) ? FRAME_ESC : c;
+}
+
+void BLEMate2Framer::encoder::flush()
+{
+}
+
+// This only ever reads.
+size_t BLEMate2Framer::encoder::write(uint8_t)
+{
+  return 0;
+}
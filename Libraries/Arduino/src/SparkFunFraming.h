@@ -0,0 +1,93 @@
+/****************************************************************
+Framing for binary data over a BC118 link
+
+The BC118 carries data as text: SND <data>\r going out, and
+RCV=<data>\n\r coming in. A carriage return or line feed in the data
+ends the command (or the line) early, so raw binary doesn't survive
+the trip. BLEMate2Framer sits on top of a BLEMate2 and fixes that: it
+escapes the troublesome bytes, wraps each message with its length and
+a CRC16, and puts messages back together on the far side, however the
+module happened to split them up.
+
+This code is beerware; if you use it, please buy me (or any other
+SparkFun employee) a cold beverage next time you run into one of
+us at the local.
+
+Code developed in Arduino 1.0.6, on an Arduino Pro 5V.
+****************************************************************/
+
+#ifndef BLEMate2Framing_h
+#define BLEMate2Framing_h
+
+#include <Arduino.h>
+#include "SparkFunBLEMate2.h"
+
+// Largest message that can be received. Messages longer than this are
+//  dropped (and counted; see badFrameCount()). The buffer is this plus three
+//  bytes of RAM. Messages can't be longer than 255 bytes in any case.
+#ifndef BLE_MATE2_FRAME_SIZE
+#define BLE_MATE2_FRAME_SIZE 64
+#endif
+
+class BLEMate2Framer
+{
+  public:
+    // Signature for the function called with each good message received.
+    typedef void (*frameCallback)(const byte *data, byte len);
+
+    BLEMate2Framer(BLEMate2 *module);
+
+    // Sending. As with the rest of the library, the begin version returns
+    //  right away, and data has to stay put until the send is done. Only one
+    //  message can be on its way at a time; beginSendFrame() returns
+    //  BUSY_ERROR if the last one hasn't gone out yet.
+    BLEMate2::opResult sendFrame(const byte *data, byte len);
+    BLEMate2::opResult beginSendFrame(const byte *data, byte len);
+
+    // Receiving. poll() reads whatever the module has received (through
+    //  its Stream functions) and passes it to feed(). If you use onData()
+    //  instead, hand the data to feed() yourself.
+    void poll();
+    void feed(byte c);
+    void feed(const char *data, byte len);
+    void onFrame(frameCallback callback);
+    unsigned int frameCount();
+    unsigned int badFrameCount();
+
+  private:
+    // Turns a message into its framed, escaped form a byte at a time, so
+    //  the module's sendData() can pull it through without us needing a
+    //  buffer for the whole thing.
+    class encoder : public Stream
+    {
+      public:
+        encoder();
+        void start(const byte *data, byte len);
+        int available();
+        int read();
+        int peek();
+        void flush();
+        size_t write(uint8_t c);
+      private:
+        const byte *_data;
+        byte _len;
+        uint16_t _crc;
+        unsigned int _pos;
+        int _escaped;
+        unsigned int _remaining;
+        byte rawByte(unsigned int pos);
+    };
+
+    BLEMate2 *_module;
+    encoder _encoder;
+    frameCallback _callback;
+    byte _rxBuf[BLE_MATE2_FRAME_SIZE + 3];
+    unsigned int _rxLen;
+    boolean _rxEscape;
+    boolean _rxBad;
+    unsigned int _frames;
+    unsigned int _badFrames;
+    void endFrame();
+};
+
+#endif
@@ -0,0 +1,210 @@
+/****************************************************************
+Support for running several BC118 modules at once
+
+See SparkFunGroup.h for how to use this.
+
+This code is beerware; if you use it, please buy me (or any other
+SparkFun employee) a cold beverage next time you run into one of
+us at the local.
+
+Code developed in Arduino 1.0.6, on an Arduino Pro 5V.
+****************************************************************/
+
+#include "SparkFunGroup.h"
+#include <Arduino.h>
+
+BLEMate2Group::BLEMate2Group()
+{
+  _count = 0;
+  _next = 0;
+  _members = 0;
+  _sending = false;
+  _sendStart = 0;
+  _sendBytes = 0;
+  _sendRate = 0;
+}
+
+BLEMate2::opResult BLEMate2Group::add(BLEMate2 *module)
+{
+  if (module == NULL || _count >= BLE_MATE2_GROUP_SIZE)
+  {
+    return BLEMate2::INVALID_PARAM;
+  }
+  _modules[_count++] = module;
+  return BLEMate2::SUCCESS;
+}
+
+byte BLEMate2Group::size()
+{
+  return _count;
+}
+
+BLEMate2 *BLEMate2Group::module(byte index)
+{
+  if (index >= _count) return NULL;
+  return _modules[index];
+}
+
+void BLEMate2Group::poll()
+{
+  if (_count == 0) return;
+  for (byte i = 0; i < _count; i++)
+  {
+    _modules[(_next + i) % _count]->poll();
+  }
+  _next = (_next + 1) % _count;
+  checkSend();
+}
+
+boolean BLEMate2Group::busy()
+{
+  for (byte i = 0; i < _count; i++)
+  {
+    if (_modules[i]->busy()) return true;
+  }
+  return false;
+}
+
+// Each module's waitForIdle() returns right away once that module is idle,
+//  so by the time we get to them, this just collects the results. Only the
+//  modules we gave something to count; a module that's been left alone
+//  might still be holding on to a failure from long ago.
+BLEMate2::opResult BLEMate2Group::waitForIdle()
+{
+  if (polling() && busy()) return BLEMate2::BUSY_ERROR;
+  while (busy())
+  {
+    poll();
+  }
+  checkSend();
+  BLEMate2::opResult result = BLEMate2::SUCCESS;
+  for (byte i = 0; i < _count; i++)
+  {
+    if (!(_members & (1U << i))) continue;
+    BLEMate2::opResult r = _modules[i]->waitForIdle();
+    if (r != BLEMate2::SUCCESS && result == BLEMate2::SUCCESS) result = r;
+  }
+  _members = 0;
+  return result;
+}
+
+// The next module, going round from the last one we picked, that has nothing
+//  queued and no connection. Returns -1 if there isn't one.
+int BLEMate2Group::pickModule()
+{
+  for (byte i = 0; i < _count; i++)
+  {
+    byte index = (_next + i) % _count;
+    if (_modules[index]->busy()) continue;
+    if (_modules[index]->connectionState() == BLEMate2::SUCCESS) continue;
+    _next = (index + 1) % _count;
+    return index;
+  }
+  return -1;
+}
+
+BLEMate2::opResult BLEMate2Group::beginScan(unsigned int timeout,
+                                            byte &which)
+{
+  int index = pickModule();
+  if (index < 0) return BLEMate2::BUSY_ERROR;
+  which = index;
+  BLEMate2::opResult result = _modules[index]->beginScan(timeout);
+  if (result == BLEMate2::SUCCESS) _members |= 1U << index;
+  return result;
+}
+
+BLEMate2::opResult BLEMate2Group::beginConnect(const String &address,
+                                               byte &which)
+{
+  int index = pickModule();
+  if (index < 0) return BLEMate2::BUSY_ERROR;
+  which = index;
+  BLEMate2::opResult result = _modules[index]->beginConnect(address);
+  if (result == BLEMate2::SUCCESS) _members |= 1U << index;
+  return result;
+}
+
+BLEMate2::opResult BLEMate2Group::beginConnect(
+  const BLEMate2::connectFilter &filter, unsigned long timeout, byte &which)
+{
+  int index = pickModule();
+  if (index < 0) return BLEMate2::BUSY_ERROR;
+  which = index;
+  BLEMate2::opResult result = _modules[index]->beginConnect(filter, timeout);
+  if (result == BLEMate2::SUCCESS) _members |= 1U << index;
+  return result;
+}
+
+BLEMate2::opResult BLEMate2Group::sendAll(const char *data, size_t len)
+{
+  if (polling()) return BLEMate2::BUSY_ERROR;
+  BLEMate2::opResult result = beginSendAll(data, len);
+  if (!_sending) return result;
+  BLEMate2::opResult sent = waitForIdle();
+  return (result != BLEMate2::SUCCESS) ? result : sent;
+}
+
+// Queue the send on every connected module, and start the clock. The
+//  group's send rate is worked out by checkSend() once they're all done,
+//  from the modules that actually got the data. CONNECT_ERROR means none of
+//  the modules was connected; otherwise the result is the first module
+//  that couldn't take the send, if any.
+BLEMate2::opResult BLEMate2Group::beginSendAll(const char *data, size_t len)
+{
+  BLEMate2::opResult result = BLEMate2::CONNECT_ERROR;
+  _sendBytes = 0;
+  _sendStart = millis();
+  for (byte i = 0; i < _count; i++)
+  {
+    if (_modules[i]->connectionState() != BLEMate2::SUCCESS) continue;
+    BLEMate2::opResult r = _modules[i]->beginSendData(data, len);
+    if (r == BLEMate2::SUCCESS)
+    {
+      _members |= 1U << i;
+      _sendBytes += len;
+    }
+    if (result == BLEMate2::CONNECT_ERROR || result == BLEMate2::SUCCESS)
+    {
+      result = r;
+    }
+  }
+  _sending = (_sendBytes > 0);
+  return result;
+}
+
+// Whether one of the modules is inside its poll(); that is, whether we've
+//  been called from one of its callbacks. That module won't poll() again
+//  until we return, so whatever it has queued can't finish while we wait,
+//  and the blocking functions turn the job down instead.
+boolean BLEMate2Group::polling()
+{
+  for (byte i = 0; i < _count; i++)
+  {
+    if (_modules[i]->_polling) return true;
+  }
+  return false;
+}
+
+void BLEMate2Group::checkSend()
+{
+  if (!_sending || busy()) return;
+  _sending = false;
+  unsigned long elapsed = millis() - _sendStart;
+  if (elapsed == 0) elapsed = 1;
+  _sendRate = (_sendBytes * 1000UL) / elapsed;
+}
+
+// Bytes per second out of the whole group for the last sendAll(), counting
+//  every module's copy of the data; and the rate for just one module, which
+//  is the same as that module's own sendRate().
+unsigned long BLEMate2Group::sendRate()
+{
+  return _sendRate;
+}
+
+unsigned long BLEMate2Group::sendRate(byte index)
+{
+  if (index >= _count) return 0;
+  return _modules[index]->sendRate();
+}
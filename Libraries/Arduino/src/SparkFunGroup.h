@@ -0,0 +1,82 @@
+/****************************************************************
+Support for running several BC118 modules at once
+
+Every BLEMate2 function that waits for the module only keeps its own
+module moving while it waits, so with more than one module, each one
+waits in line behind the others. BLEMate2Group keeps all of them
+moving together: use the begin*() functions (on the group or on the
+modules themselves) and let the group's poll() do the waiting.
+
+This code is beerware; if you use it, please buy me (or any other
+SparkFun employee) a cold beverage next time you run into one of
+us at the local.
+
+Code developed in Arduino 1.0.6, on an Arduino Pro 5V.
+****************************************************************/
+
+#ifndef BLEMate2Group_h
+#define BLEMate2Group_h
+
+#include <Arduino.h>
+#include "SparkFunBLEMate2.h"
+
+// Most modules a group can hold, up to 16. Each one costs a pointer's worth
+//  of RAM.
+#ifndef BLE_MATE2_GROUP_SIZE
+#define BLE_MATE2_GROUP_SIZE 4
+#endif
+#if BLE_MATE2_GROUP_SIZE > 16
+#error "BLE_MATE2_GROUP_SIZE can't be more than 16"
+#endif
+
+class BLEMate2Group
+{
+  public:
+    BLEMate2Group();
+    BLEMate2::opResult add(BLEMate2 *module);
+    byte size();
+    BLEMate2 *module(byte index);
+
+    // Keeping things moving. poll() polls every module once, starting with
+    //  a different one each time so none of them is always last in line.
+    //  waitForIdle() polls until none of them has anything to do, and
+    //  returns the first failure (or SUCCESS) among the modules the group
+    //  has handed work to since the last waitForIdle(). For work you gave a
+    //  module yourself, ask the module. Like the modules' own blocking
+    //  functions, waitForIdle() and sendAll() can't wait from inside one of
+    //  the modules' callbacks; there, they return BUSY_ERROR.
+    void poll();
+    boolean busy();
+    BLEMate2::opResult waitForIdle();
+
+    // Spreading work around. These hand the job to the next module that
+    //  isn't busy and isn't connected to anything, and tell you which one
+    //  got it; BUSY_ERROR means none of them was free.
+    int pickModule();
+    BLEMate2::opResult beginScan(unsigned int timeout, byte &which);
+    BLEMate2::opResult beginConnect(const String &address, byte &which);
+    BLEMate2::opResult beginConnect(const BLEMate2::connectFilter &filter,
+                                    unsigned long timeout, byte &which);
+
+    // Sending the same data out of every connected module at once. The
+    //  data has to stay put until the sends are done. If a module's queue is
+    //  full, the others send anyway, and the result is BUSY_ERROR.
+    BLEMate2::opResult sendAll(const char *data, size_t len);
+    BLEMate2::opResult beginSendAll(const char *data, size_t len);
+    unsigned long sendRate();
+    unsigned long sendRate(byte index);
+
+  private:
+    BLEMate2 *_modules[BLE_MATE2_GROUP_SIZE];
+    byte _count;
+    byte _next;
+    unsigned int _members;
+    boolean _sending;
+    unsigned long _sendStart;
+    unsigned long _sendBytes;
+    unsigned long _sendRate;
+    void checkSend();
+    boolean polling();
+};
+
+#endif
@@ -0,0 +1,107 @@
+/****************************************************************
+Optional statistics for BC118 modules.
+
+None of this is compiled in unless BLE_MATE2_STATS is set to 1
+in SparkFunBLEMate2.h.
+
+This code is beerware; if you use it, please buy me (or any other
+SparkFun employee) a cold beverage next time you run into one of
+us at the local.
+
+Code developed in Arduino 1.0.6, on an Arduino Pro 5V.
+****************************************************************/
+
+#include "SparkFunBLEMate2.h"
+#include <Arduino.h>
+
+#if BLE_MATE2_STATS
+
+// Called by popCommand() for every command that finishes, however it ends.
+void BLEMate2::recordStats(cmdEntry *cmd, opResult result)
+{
+  cmdStats *s = &_stats.cmd[cmd->type];
+  s->count++;
+  if (result == MODULE_ERROR) s->errors++;
+  if (result == TIMEOUT_ERROR) s->timeouts++;
+  if (!cmd->written) return;
+
+  unsigned long elapsed = millis() - cmd->sentAt;
+  s->timed++;
+  if (s->timed == 1 || elapsed < s->minTime) s->minTime = elapsed;
+  if (elapsed > s->maxTime) s->maxTime = elapsed;
+  s->totalTime += elapsed;
+}
+
+void BLEMate2::getStats(stats &out)
+{
+  out = _stats;
+}
+
+void BLEMate2::resetStats()
+{
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+// Lines from the module that the command waiting for an answer has no use
+//  for. Most commands only care about OK, ERR and the event lines, so any
+//  other text is stray; a GET wants the line with its value, and a reset or
+//  VER has a whole banner to get through first.
+boolean BLEMate2::strayLine(cmdEntry *cmd, lineType line)
+{
+  if (line != LINE_OTHER) return false;
+  switch (cmd->type)
+  {
+    case CMD_GET:
+    case CMD_CONFIG:
+      return getAnswer(cmd) == NULL;
+    case CMD_VERSION:
+    case CMD_RESET:
+      return false;
+    default:
+      return true;
+  }
+}
+
+// The names dumpStats() uses, by cmdType. Like the command text, these live
+//  in flash.
+static const char statNames[BLEMate2::CMD_TYPES][4] PROGMEM =
+  {"", "STD", "GET", "STS", "VER", "RST", "SCN", "CON", "DCN", "SND", "CFG"};
+
+// One line, something like this:
+//  STD 12/0/0 3<4<9 GET 4/0/0 3<3<4 tx 310 rx 522 uns 1 rs 1
+//  For each kind of command that's been used: count/errors/timeouts, then
+//  min<average<max time in milliseconds. Anything that never went out (an
+//  aborted batch, say) is counted but not timed.
+void BLEMate2::dumpStats(Print &out)
+{
+  for (byte i = 1; i < CMD_TYPES; i++)
+  {
+    cmdStats *s = &_stats.cmd[i];
+    if (s->count == 0) continue;
+    unsigned long average = s->timed ? s->totalTime / s->timed : 0;
+    out.print((const __FlashStringHelper *)statNames[i]);
+    out.print(' ');
+    out.print(s->count);
+    out.print('/');
+    out.print(s->errors);
+    out.print('/');
+    out.print(s->timeouts);
+    out.print(' ');
+    out.print(s->minTime);
+    out.print('<');
+    out.print(average);
+    out.print('<');
+    out.print(s->maxTime);
+    out.print(' ');
+  }
+  out.print(F("tx "));
+  out.print(_stats.bytesOut);
+  out.print(F(" rx "));
+  out.print(_stats.bytesIn);
+  out.print(F(" uns "));
+  out.print(_stats.unsolicited);
+  out.print(F(" rs "));
+  out.println(_stats.resyncs);
+}
+
+#endif
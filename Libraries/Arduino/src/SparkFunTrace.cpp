@@ -0,0 +1,107 @@
+/****************************************************************
+Optional wire-level trace for BC118 modules.
+
+None of this is compiled in unless BLE_MATE2_TRACE_SIZE is set in
+SparkFunBLEMate2.h.
+
+This code is beerware; if you use it, please buy me (or any other
+SparkFun employee) a cold beverage next time you run into one of
+us at the local.
+
+Code developed in Arduino 1.0.6, on an Arduino Pro 5V.
+****************************************************************/
+
+#include "SparkFunBLEMate2.h"
+#include <Arduino.h>
+
+#if BLE_MATE2_TRACE_SIZE > 0
+
+// The trace is a ring of two-byte entries, oldest overwritten first. The
+//  first byte of each is a tag: the top bit is set for a byte we sent and
+//  clear for one we received, and the rest is the number of milliseconds
+//  since the entry before it (0-126). The second byte is the byte itself.
+//  A longer wait gets a TRACE_GAP entry of its own first, whose second byte
+//  is the wait in tenths of a second (up to 25.5 seconds; anything longer
+//  shows up as 25.5), and the entry after it has the leftover milliseconds.
+#define TRACE_TX      0x80
+#define TRACE_GAP     0x7F
+#define TRACE_ENTRIES (BLE_MATE2_TRACE_SIZE / 2)
+
+void BLEMate2::clearTrace()
+{
+  _traceHead = 0;
+  _traceCount = 0;
+  _traceLast = 0;
+}
+
+void BLEMate2::traceByte(boolean tx, byte c)
+{
+  unsigned long now = millis();
+  unsigned long gap = (_traceCount == 0) ? 0 : now - _traceLast;
+  _traceLast = now;
+  if (gap >= TRACE_GAP)
+  {
+    unsigned long tenths = gap / 100;
+    traceEntry(TRACE_GAP, (tenths > 255) ? 255 : tenths);
+    gap %= 100;
+  }
+  traceEntry((tx ? TRACE_TX : 0) | gap, c);
+}
+
+void BLEMate2::traceEntry(byte tag, byte c)
+{
+  unsigned int slot = (_traceHead + _traceCount) % TRACE_ENTRIES;
+  if (_traceCount < TRACE_ENTRIES) _traceCount++;
+  else _traceHead = (_traceHead + 1) % TRACE_ENTRIES;
+  _trace[slot * 2] = tag;
+  _trace[slot * 2 + 1] = c;
+}
+
+// Print the trace as text, oldest first. Each line is a time in milliseconds
+//  (from the oldest entry we still have), T for bytes we sent or R for bytes
+//  we received, and then the bytes in hex. Bytes go on the same line as long
+//  as they're going the same way and no more than a couple of milliseconds
+//  apart, so each line is more or less one burst of traffic, something like:
+//    0 T 53 54 53 0D
+//    4 R 53 54 53 20 50 20 49 44 4C 45 0A 0D
+// That's easy to read by eye, and easy to turn back into a stream of bytes
+//  and times: extras/host/TraceReplay plays a dump back to the library on a
+//  PC, in place of the module it came from.
+void BLEMate2::dumpTrace(Print &out)
+{
+  unsigned long t = 0;
+  byte lineDir = 0xFF;
+  byte lineBytes = 0;
+  boolean started = false;
+  for (unsigned int i = 0; i < _traceCount; i++)
+  {
+    unsigned int slot = (_traceHead + i) % TRACE_ENTRIES;
+    byte tag = _trace[slot * 2];
+    byte c = _trace[slot * 2 + 1];
+    if (tag == TRACE_GAP)
+    {
+      if (i > 0) t += c * 100UL;
+      lineBytes = 0;
+      continue;
+    }
+    byte gap = tag & ~TRACE_TX;
+    byte dir = tag & TRACE_TX;
+    if (i > 0) t += gap;
+    if (dir != lineDir || gap > 2 || lineBytes == 0 || lineBytes >= 16)
+    {
+      if (started) out.println();
+      started = true;
+      out.print(t);
+      out.print(dir ? F(" T") : F(" R"));
+      lineDir = dir;
+      lineBytes = 0;
+    }
+    out.print(' ');
+    if (c < 0x10) out.print('0');
+    out.print(c, HEX);
+    lineBytes++;
+  }
+  if (started) out.println();
+}
+
+#endif